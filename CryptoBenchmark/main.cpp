@@ -0,0 +1,648 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "corpus.h"
+#include "indexed_text.h"
+#include "allocation_counter.h"
+#include "CryptoCaesarCipher/caesar.h"
+#include "CryptoDirectSubstitution/direct_substitution.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+#include "CryptoMatrixSubstitution/matrix_substitution.h"
+#include "CryptoBlockTransposition/block_transposition.h"
+#include "CryptoColumnTransposition/column_transposition.h"
+#include "CryptoZorgeCypher/checkerboard.h"
+#include "CryptoService/chains.h"
+
+constexpr const uint64_t CORPUS_SEED = 0x5eed;
+constexpr const size_t MIN_ITERATIONS = 5;
+constexpr const size_t MAX_ITERATIONS = 100000;
+
+//one prepared input; run() ciphers it once and returns the output size so the result stays observable
+struct workload {
+    size_t input_bytes;
+    std::function<size_t()> run;
+};
+
+struct benchmark_case {
+    std::string cipher;
+    std::string operation;
+    std::function<workload(size_t symbols)> prepare;
+};
+
+struct benchmark_result {
+    std::string cipher;
+    std::string operation;
+    size_t symbols;
+    size_t bytes;
+    size_t iterations;
+    double mb_per_s;
+    double ns_per_symbol;
+    double allocations_per_call;
+    double p50_ns;
+    double p99_ns;
+};
+
+using index_buffer = std::vector<indexed_text::index_type>;
+
+//the indexed_text form of a generated corpus
+template<typename Alphabet>
+std::shared_ptr<index_buffer> to_indices(const std::wstring& text) {
+    auto result = std::make_shared<index_buffer>(text.size());
+    indexed_text::to_indices<Alphabet>(text.data(), text.data() + text.size(), result->data());
+    return result;
+}
+
+//input of the byte modes, every byte value is a symbol there
+std::shared_ptr<std::vector<uint8_t>> random_bytes(size_t size) {
+    auto result = std::make_shared<std::vector<uint8_t>>(size);
+    std::mt19937 generator(CORPUS_SEED);
+    std::generate(result->begin(), result->end(), [&]() { return uint8_t(generator()); });
+    return result;
+}
+
+std::vector<benchmark_case> make_cases() {
+    std::vector<benchmark_case> cases;
+
+    cases.push_back({"caesar", "encrypt", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(caesar::all_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return caesar::do_cipher(input, caesar::Encrypt).size();
+        }};
+    }});
+    cases.push_back({"caesar", "decrypt", [](size_t symbols) {
+        auto input = caesar::do_cipher(corpus_generator(CORPUS_SEED).generate(caesar::all_symbols, symbols),
+                                       caesar::Encrypt);
+        return workload{utf8_length(input), [=]() {
+            return caesar::do_cipher(input, caesar::Decrypt).size();
+        }};
+    }});
+    cases.push_back({"caesar", "encrypt_into", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(caesar::all_symbols, symbols);
+        auto output = std::make_shared<std::wstring>(input.size(), L'\0');
+        return workload{utf8_length(input), [=]() {
+            caesar::cipher_into(input.data(), input.data() + input.size(), &(*output)[0], caesar::Encrypt);
+            return output->size();
+        }};
+    }});
+    cases.push_back({"caesar", "encrypt_indices_into", [](size_t symbols) {
+        auto text = corpus_generator(CORPUS_SEED).generate(caesar::all_symbols, symbols);
+        auto input = to_indices<caesar::symbols_type>(text);
+        auto output = std::make_shared<index_buffer>(input->size());
+        return workload{utf8_length(text), [=]() {
+            caesar::cipher_into(input->data(), input->data() + input->size(), output->data(), caesar::Encrypt);
+            return output->size();
+        }};
+    }});
+    //UTF-8 in, UTF-8 out without a wide copy of the text
+    cases.push_back({"caesar", "encrypt_utf8_indices_into", [](size_t symbols) {
+        using alphabet = caesar::symbols_type;
+        std::wstring text = corpus_generator(CORPUS_SEED).generate(caesar::all_symbols, symbols);
+        std::string input(utf8::max_encoded(text.size()), '\0');
+        input.resize(utf8::encode(text.data(), text.data() + text.size(), &input[0]));
+        auto indices = std::make_shared<index_buffer>(input.size());
+        auto output = std::make_shared<std::string>(input.size() * 4, '\0');
+        return workload{input.size(), [=]() {
+            size_t length = indexed_text::decode<alphabet>(input.data(), input.data() + input.size(), indices->data());
+            caesar::cipher_into(indices->data(), indices->data() + length, indices->data(), caesar::Encrypt);
+            return indexed_text::encode<alphabet>(indices->data(), indices->data() + length, &(*output)[0]);
+        }};
+    }});
+    cases.push_back({"caesar", "encrypt_bytes_into", [](size_t symbols) {
+        auto input = random_bytes(symbols);
+        auto output = std::make_shared<std::vector<uint8_t>>(symbols);
+        return workload{symbols, [=]() {
+            caesar::cipher_bytes(input->data(), input->data() + input->size(), output->data(), caesar::Encrypt);
+            return output->size();
+        }};
+    }});
+
+    cases.push_back({"direct_substitution", "encrypt", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(direct_substitution::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            std::vector<int> result;
+            std::transform(input.begin(), input.end(), std::back_inserter(result),
+                           direct_substitution::encryptor());
+            return result.size();
+        }};
+    }});
+    cases.push_back({"direct_substitution", "decrypt", [](size_t symbols) {
+        auto plain = corpus_generator(CORPUS_SEED).generate(direct_substitution::allowed_symbols, symbols);
+        std::string input;
+        for (wchar_t symbol : plain) {
+            input += std::to_string(direct_substitution::encryptor()(symbol));
+            input += ' ';
+        }
+        return workload{input.size(), [=]() {
+            std::wstring result;
+            result.reserve(input.size() / 2 + 1);
+            direct_substitution::decryptor decrypt(direct_substitution::number_to_symbol, SIZE_MAX);
+            return decrypt(input.data(), input.data() + input.size(), std::back_inserter(result));
+        }};
+    }});
+    cases.push_back({"direct_substitution", "encrypt_into", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(direct_substitution::allowed_symbols, symbols);
+        auto output = std::make_shared<std::string>(input.size() * direct_substitution::max_code_chars, '\0');
+        return workload{utf8_length(input), [=]() {
+            return direct_substitution::write_codes(input.data(), input.data() + input.size(), &(*output)[0]);
+        }};
+    }});
+    cases.push_back({"direct_substitution", "encrypt_indices_into", [](size_t symbols) {
+        auto text = corpus_generator(CORPUS_SEED).generate(direct_substitution::allowed_symbols, symbols);
+        auto input = to_indices<direct_substitution::symbols_type>(text);
+        auto output = std::make_shared<std::string>(input->size() * direct_substitution::max_code_chars, '\0');
+        return workload{utf8_length(text), [=]() {
+            return direct_substitution::write_codes(input->data(), input->data() + input->size(), &(*output)[0]);
+        }};
+    }});
+    cases.push_back({"direct_substitution", "decrypt_into", [](size_t symbols) {
+        auto plain = corpus_generator(CORPUS_SEED).generate(direct_substitution::allowed_symbols, symbols);
+        std::string input(plain.size() * direct_substitution::max_code_chars, '\0');
+        input.resize(direct_substitution::write_codes(plain.data(), plain.data() + plain.size(), &input[0]));
+        auto output = std::make_shared<std::wstring>(input.size(), L'\0');
+        return workload{input.size(), [=]() {
+            direct_substitution::decryptor decrypt(direct_substitution::number_to_symbol, SIZE_MAX);
+            return decrypt(input.data(), input.data() + input.size(), &(*output)[0]);
+        }};
+    }});
+
+    const std::wstring polyalphabetic_key = L"ТАЙНА2024";
+    cases.push_back({"polyalphabetic", "encrypt", [=](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            std::wstring result;
+            std::transform(input.begin(), input.end(), std::back_inserter(result),
+                           polyalphabetic::encryptor<>(polyalphabetic_key));
+            return result.size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "encrypt_parallel", [=](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return polyalphabetic::parallel_cipher(input, polyalphabetic::Encrypt, polyalphabetic_key).size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "encrypt_tuned", [=](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return polyalphabetic::cipher(input, polyalphabetic::Encrypt, polyalphabetic_key).size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "encrypt_into", [=](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        auto output = std::make_shared<std::wstring>(input.size(), L'\0');
+        return workload{utf8_length(input), [=]() {
+            std::transform(input.begin(), input.end(), output->begin(),
+                           polyalphabetic::encryptor<>(polyalphabetic_key));
+            return output->size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "encrypt_indices_into", [=](size_t symbols) {
+        auto text = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        auto input = to_indices<polyalphabetic::symbols_type>(text);
+        auto key = to_indices<polyalphabetic::symbols_type>(polyalphabetic_key);
+        auto output = std::make_shared<index_buffer>(input->size());
+        return workload{utf8_length(text), [=]() {
+            polyalphabetic::cipher_into(input->data(), input->data() + input->size(), polyalphabetic::Encrypt,
+                                        key->data(), key->size(), output->data());
+            return output->size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "encrypt_bytes_into", [=](size_t symbols) {
+        auto input = random_bytes(symbols);
+        auto output = std::make_shared<std::vector<uint8_t>>(symbols);
+        return workload{symbols, [=]() {
+            const char key[] = "SECRET-KEY";
+            polyalphabetic::cipher_bytes(input->data(), input->data() + input->size(), polyalphabetic::Encrypt,
+                                         reinterpret_cast<const uint8_t*>(key), sizeof(key) - 1, output->data());
+            return output->size();
+        }};
+    }});
+    cases.push_back({"polyalphabetic", "decrypt", [=](size_t symbols) {
+        auto plain = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        std::wstring input;
+        std::transform(plain.begin(), plain.end(), std::back_inserter(input),
+                       polyalphabetic::encryptor<>(polyalphabetic_key));
+        return workload{utf8_length(input), [=]() {
+            std::wstring result;
+            std::transform(input.begin(), input.end(), std::back_inserter(result),
+                           polyalphabetic::decryptor<>(polyalphabetic_key));
+            return result.size();
+        }};
+    }});
+
+    cases.push_back({"frequency", "histogram", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return size_t(histogram<polyalphabetic::symbols_type>::parallel(input).total());
+        }};
+    }});
+    cases.push_back({"frequency", "sliding_coincidence", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            size_t windows = 0;
+            sliding_coincidence<polyalphabetic::symbols_type>::scan(input.data(), input.data() + input.size(), 256,
+                                                                    [&](size_t, double) { ++windows; });
+            return windows;
+        }};
+    }});
+
+    cases.push_back({"matrix_substitution", "encrypt", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(matrix_substitution::symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return matrix_substitution::encrypt(input, L"ТАЙНА").size();
+        }};
+    }});
+    cases.push_back({"matrix_substitution", "encrypt_parallel", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(matrix_substitution::symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return matrix_substitution::parallel_encrypt(input, L"ТАЙНА").size();
+        }};
+    }});
+    cases.push_back({"matrix_substitution", "encrypt_into", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(matrix_substitution::symbols, symbols);
+        auto output = std::make_shared<std::wstring>(input.size(), L'\0');
+        return workload{utf8_length(input), [=]() {
+            matrix_substitution::encrypt_into(input.data(), input.data() + input.size(), L"ТАЙНА", &(*output)[0]);
+            return output->size();
+        }};
+    }});
+
+    cases.push_back({"block_transposition", "encrypt", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(block_transposition::symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return block_transposition::encryptor(input, L"ШИФРОВКА").encrypt().size();
+        }};
+    }});
+    cases.push_back({"block_transposition", "encrypt_into", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(block_transposition::symbols, symbols);
+        auto output = std::make_shared<std::wstring>(block_transposition::encrypted_size(input.size(), 8), L'\0');
+        return workload{utf8_length(input), [=]() {
+            block_transposition::encrypt_into(input.data(), input.data() + input.size(), L"ШИФРОВКА", &(*output)[0]);
+            return output->size();
+        }};
+    }});
+
+    cases.push_back({"column_transposition", "encrypt", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(column_transposition::symbols, symbols);
+        return workload{utf8_length(input), [=]() {
+            return column_transposition::encryptor(input, L"ШИФРОВКА").encrypt().size();
+        }};
+    }});
+    cases.push_back({"column_transposition", "encrypt_into", [](size_t symbols) {
+        auto input = corpus_generator(CORPUS_SEED).generate(column_transposition::symbols, symbols);
+        auto output = std::make_shared<std::wstring>(column_transposition::encrypted_size(input.size(), 8), L'\0');
+        return workload{utf8_length(input), [=]() {
+            column_transposition::encrypt_into(input.data(), input.data() + input.size(), L"ШИФРОВКА", &(*output)[0]);
+            return output->size();
+        }};
+    }});
+    cases.push_back({"column_transposition", "encrypt_indices_into", [](size_t symbols) {
+        auto text = corpus_generator(CORPUS_SEED).generate(column_transposition::symbols, symbols);
+        auto input = to_indices<column_transposition::symbols_type>(text);
+        auto output = std::make_shared<index_buffer>(column_transposition::encrypted_size(input->size(), 8));
+        return workload{utf8_length(text), [=]() {
+            column_transposition::encrypt_into(input->data(), input->data() + input->size(), L"ШИФРОВКА",
+                                               output->data(), column_transposition::padding_index);
+            return output->size();
+        }};
+    }});
+    cases.push_back({"column_transposition", "encrypt_indices_wide_key", [](size_t symbols) {
+        //rows of 4096 symbols, longer than L1 holds, and a key repeating every symbol many times
+        auto text = corpus_generator(CORPUS_SEED).generate(column_transposition::symbols, symbols);
+        auto key = std::make_shared<std::wstring>(
+                corpus_generator(CORPUS_SEED + 1).generate(column_transposition::symbols, 4096));
+        auto input = to_indices<column_transposition::symbols_type>(text);
+        auto output = std::make_shared<index_buffer>(column_transposition::encrypted_size(input->size(), key->size()));
+        return workload{utf8_length(text), [=]() {
+            column_transposition::encrypt_into(input->data(), input->data() + input->size(), *key, output->data(),
+                                               column_transposition::padding_index);
+            return output->size();
+        }};
+    }});
+
+    cases.push_back({"zorge", "encrypt", [](size_t symbols) {
+        std::string alphabet = std::string(zorge::symbol_set) + "0123456789";
+        auto input = corpus_generator(CORPUS_SEED).generate(alphabet.c_str(), symbols);
+        auto enc = std::make_shared<zorge::encryptor>();
+        return workload{utf8_length(input), [=]() {
+            return enc->encrypt(input, "SOMBRE").size();
+        }};
+    }});
+    cases.push_back({"zorge", "encrypt_into", [](size_t symbols) {
+        std::string alphabet = std::string(zorge::symbol_set) + "0123456789";
+        auto input = corpus_generator(CORPUS_SEED).generate(alphabet.c_str(), symbols);
+        auto enc = std::make_shared<zorge::encryptor>();
+        auto output = std::make_shared<std::string>(input.size() * zorge::max_code_chars, '\0');
+        return workload{utf8_length(input), [=]() {
+            return zorge::encryptor::encrypt_into(input.data(), input.data() + input.size(),
+                                                  enc->cached_checkerboard("SOMBRE"), &(*output)[0]);
+        }};
+    }});
+
+    //the service chains, every stage materialized into a buffer of its own against chains.h
+    cases.push_back({"chain", "zorge_block_staged", [](size_t symbols) {
+        std::string alphabet = std::string(zorge::symbol_set) + "0123456789";
+        auto input = corpus_generator(CORPUS_SEED).generate(alphabet.c_str(), symbols);
+        auto enc = std::make_shared<zorge::encryptor>();
+        auto codes = std::make_shared<std::string>(input.size() * zorge::max_code_chars, '\0');
+        auto output = std::make_shared<std::string>(chains::zorge_block_size(input.size(), 8), '\0');
+        return workload{utf8_length(input), [=]() {
+            size_t length = zorge::encryptor::encrypt_into(input.data(), input.data() + input.size(),
+                                                           enc->cached_checkerboard("SOMBRE"), &(*codes)[0]);
+            auto writer = std::copy(codes->data(), codes->data() + length,
+                                    block_transposition::block_writer<char>(L"ШИФРОВКА", &(*output)[0]));
+            return size_t(writer.finish(' ') - output->data());
+        }};
+    }});
+    cases.push_back({"chain", "zorge_block_fused", [](size_t symbols) {
+        std::string alphabet = std::string(zorge::symbol_set) + "0123456789";
+        auto input = corpus_generator(CORPUS_SEED).generate(alphabet.c_str(), symbols);
+        auto enc = std::make_shared<zorge::encryptor>();
+        auto output = std::make_shared<std::string>(chains::zorge_block_size(input.size(), 8), '\0');
+        return workload{utf8_length(input), [=]() {
+            return chains::zorge_block(input.data(), input.data() + input.size(), enc->cached_checkerboard("SOMBRE"),
+                                       L"ШИФРОВКА", &(*output)[0]);
+        }};
+    }});
+    cases.push_back({"chain", "polyalphabetic_column_staged", [=](size_t symbols) {
+        using alphabet = polyalphabetic::symbols_type;
+        auto text = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        auto input = to_indices<alphabet>(text);
+        auto key = to_indices<alphabet>(polyalphabetic_key);
+        const size_t padded_size = polyalphabetic::cipher_worker<>::padded_size(input->size(), key->size());
+        auto padded = std::make_shared<index_buffer>(padded_size, alphabet::index_of(L'*'));
+        auto ciphered = std::make_shared<index_buffer>(padded_size);
+        auto output = std::make_shared<index_buffer>(column_transposition::encrypted_size(padded_size, 8));
+        return workload{utf8_length(text), [=]() {
+            size_t left = (padded_size - input->size() + 1) / 2;
+            std::copy(input->begin(), input->end(), padded->begin() + left);
+            polyalphabetic::cipher_into(padded->data(), padded->data() + padded_size, polyalphabetic::Encrypt,
+                                        key->data(), key->size(), ciphered->data());
+            column_transposition::encrypt_into(ciphered->data(), ciphered->data() + padded_size, L"ШИФРОВКА",
+                                               output->data(), indexed_text::index_type(alphabet::index_of(L' ')));
+            return output->size();
+        }};
+    }});
+    cases.push_back({"chain", "polyalphabetic_column_fused", [=](size_t symbols) {
+        auto text = corpus_generator(CORPUS_SEED).generate(polyalphabetic::allowed_symbols, symbols);
+        auto input = to_indices<polyalphabetic::symbols_type>(text);
+        auto key = to_indices<polyalphabetic::symbols_type>(polyalphabetic_key);
+        auto output = std::make_shared<index_buffer>(
+                chains::polyalphabetic_column_size(input->size(), key->size(), 8));
+        return workload{utf8_length(text), [=]() {
+            return chains::polyalphabetic_column(input->data(), input->data() + input->size(), key->data(),
+                                                 key->size(), L"ШИФРОВКА", output->data());
+        }};
+    }});
+
+    //preparing one of key_count keys per message, as a service reusing a few hundred keys does
+    constexpr size_t key_count = 256;
+    auto block_keys = std::make_shared<std::vector<std::wstring>>();
+    auto zorge_keys = std::make_shared<std::vector<std::string>>();
+    for (size_t i = 0; i < key_count; ++i) {
+        block_keys->push_back(corpus_generator(CORPUS_SEED + i).generate(block_transposition::symbols, 8));
+        std::string symbols = zorge::symbol_set;
+        std::shuffle(symbols.begin(), symbols.end(), std::mt19937(i));
+        zorge_keys->push_back(symbols.substr(0, zorge::REQUIRED_KEY_LEN));
+    }
+    cases.push_back({"key_schedule", "block_build", [=](size_t symbols) {
+        return workload{symbols, [=]() {
+            int sum = 0;
+            for (size_t i = 0; i < symbols; ++i) {
+                sum += block_transposition::parse_key_to_indices((*block_keys)[i % key_count])[0];
+            }
+            return size_t(sum);
+        }};
+    }});
+    cases.push_back({"key_schedule", "block_cached", [=](size_t symbols) {
+        return workload{symbols, [=]() {
+            int sum = 0;
+            for (size_t i = 0; i < symbols; ++i) {
+                sum += block_transposition::key_schedules().get((*block_keys)[i % key_count],
+                                                                block_transposition::parse_key_to_indices)[0];
+            }
+            return size_t(sum);
+        }};
+    }});
+    cases.push_back({"key_schedule", "zorge_build", [=](size_t symbols) {
+        auto enc = std::make_shared<zorge::encryptor>();
+        return workload{symbols, [=]() {
+            size_t sum = 0;
+            for (size_t i = 0; i < symbols; ++i) {
+                sum += enc->build_checkerboard((*zorge_keys)[i % key_count]).row_length;
+            }
+            return sum;
+        }};
+    }});
+    cases.push_back({"key_schedule", "zorge_cached", [=](size_t symbols) {
+        auto enc = std::make_shared<zorge::encryptor>();
+        return workload{symbols, [=]() {
+            size_t sum = 0;
+            for (size_t i = 0; i < symbols; ++i) {
+                sum += enc->cached_checkerboard((*zorge_keys)[i % key_count]).row_length;
+            }
+            return sum;
+        }};
+    }});
+
+    return cases;
+}
+
+benchmark_result measure(const benchmark_case& bench, size_t symbols, std::chrono::milliseconds min_time) {
+    using clock = std::chrono::steady_clock;
+
+    workload load = bench.prepare(symbols);
+    volatile size_t sink = load.run(); //warm-up, also faults in the input
+
+    std::vector<double> samples;
+    samples.reserve(MAX_ITERATIONS);
+    size_t allocations_before = allocation_counter::total.load();
+    auto start = clock::now();
+
+    while (samples.size() < MIN_ITERATIONS ||
+           (clock::now() - start < min_time && samples.size() < MAX_ITERATIONS)) {
+        auto begin = clock::now();
+        sink = load.run();
+        auto end = clock::now();
+        samples.push_back(std::chrono::duration<double, std::nano>(end - begin).count());
+    }
+    size_t allocations = allocation_counter::total.load() - allocations_before;
+    (void) sink;
+
+    double total_ns = 0;
+    for (double sample : samples) {
+        total_ns += sample;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    benchmark_result result;
+    result.cipher = bench.cipher;
+    result.operation = bench.operation;
+    result.symbols = symbols;
+    result.bytes = load.input_bytes;
+    result.iterations = samples.size();
+    result.mb_per_s = double(load.input_bytes) * samples.size() / (total_ns / 1e9) / 1e6;
+    result.ns_per_symbol = total_ns / samples.size() / symbols;
+    result.allocations_per_call = double(allocations) / samples.size();
+    result.p50_ns = samples[samples.size() / 2];
+    result.p99_ns = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    return result;
+}
+
+std::string to_json(const benchmark_result& result) {
+    std::ostringstream out;
+    out << "{\"cipher\":\"" << result.cipher << "\",\"operation\":\"" << result.operation << "\""
+        << ",\"symbols\":" << result.symbols << ",\"bytes\":" << result.bytes
+        << ",\"iterations\":" << result.iterations << ",\"mb_per_s\":" << result.mb_per_s
+        << ",\"ns_per_symbol\":" << result.ns_per_symbol
+        << ",\"allocations_per_call\":" << result.allocations_per_call
+        << ",\"p50_ns\":" << result.p50_ns << ",\"p99_ns\":" << result.p99_ns << "}";
+    return out.str();
+}
+
+//extracts a field from one line of our own output, not a general JSON parser
+std::string json_field(const std::string& line, const std::string& field) {
+    std::string pattern = "\"" + field + "\":";
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) {
+        return "";
+    }
+    pos += pattern.size();
+    if (line[pos] == '"') {
+        return line.substr(pos + 1, line.find('"', pos + 1) - pos - 1);
+    }
+    return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+//compares against a previous run, returns the number of cases slower than the threshold; throws for unusable baselines
+int compare_to_baseline(const std::vector<benchmark_result>& results, const std::string& path, double threshold) {
+    std::ifstream baseline(path);
+    if (!baseline) {
+        throw std::runtime_error("Cannot open baseline " + path);
+    }
+    int regressions = 0;
+    std::string line;
+    while (getline(baseline, line)) {
+        std::string cipher = json_field(line, "cipher");
+        if (cipher.empty()) {
+            continue;
+        }
+        std::string operation = json_field(line, "operation");
+        size_t symbols = std::stoul(json_field(line, "symbols"));
+        std::string ns_field = json_field(line, "ns_per_symbol");
+        double baseline_ns = ns_field.empty() ? 0 : std::stod(ns_field);
+        //the change is relative to it; also rejects nan
+        if (!(baseline_ns > 0)) {
+            throw std::runtime_error("Baseline " + path + " has no positive ns_per_symbol for " + cipher + ' ' +
+                                     operation + ' ' + std::to_string(symbols));
+        }
+
+        for (const auto& result : results) {
+            if (result.cipher != cipher || result.operation != operation || result.symbols != symbols) {
+                continue;
+            }
+            double change = (result.ns_per_symbol - baseline_ns) / baseline_ns * 100;
+            if (change > threshold) {
+                std::cerr << "regression: " << cipher << ' ' << operation << ' ' << symbols << " symbols: "
+                          << baseline_ns << " -> " << result.ns_per_symbol << " ns/symbol (+" << change << "%)"
+                          << std::endl;
+                ++regressions;
+            }
+        }
+    }
+    return regressions;
+}
+
+//the *_into operations write into caller provided buffers and must not allocate
+int count_allocating_into_cases(const std::vector<benchmark_result>& results) {
+    const std::string suffix = "_into";
+    int failures = 0;
+    for (const auto& result : results) {
+        if (result.operation.size() > suffix.size() &&
+            result.operation.compare(result.operation.size() - suffix.size(), suffix.size(), suffix) == 0 &&
+            result.allocations_per_call != 0) {
+            std::cerr << "allocation: " << result.cipher << ' ' << result.operation << ' ' << result.symbols
+                      << " symbols: " << result.allocations_per_call << " allocations per call" << std::endl;
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::istringstream in(list);
+    std::string item;
+    while (getline(in, item, ',')) {
+        sizes.push_back(std::stoul(item));
+    }
+    return sizes;
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoBenchmark [--sizes 64,4096,262144] [--min-time-ms 200] [--filter cipher]\n"
+                 "                       [--baseline results.json] [--threshold percent]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {64, 4096, 262144};
+    std::chrono::milliseconds min_time(200);
+    std::string filter;
+    std::string baseline;
+    double threshold = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        if (arg == "--sizes") {
+            sizes = parse_sizes(argv[++i]);
+        } else if (arg == "--min-time-ms") {
+            min_time = std::chrono::milliseconds(std::stol(argv[++i]));
+        } else if (arg == "--filter") {
+            filter = argv[++i];
+        } else if (arg == "--baseline") {
+            baseline = argv[++i];
+        } else if (arg == "--threshold") {
+            threshold = std::stod(argv[++i]);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+
+    std::vector<benchmark_result> results;
+    std::cout << "[" << std::endl;
+    for (const auto& bench : make_cases()) {
+        if (!filter.empty() && bench.cipher.find(filter) == std::string::npos) {
+            continue;
+        }
+        for (size_t symbols : sizes) {
+            results.push_back(measure(bench, symbols, min_time));
+            std::cout << (results.size() == 1 ? "" : ",\n") << to_json(results.back()) << std::flush;
+        }
+    }
+    std::cout << "\n]" << std::endl;
+
+    int failures = count_allocating_into_cases(results);
+    if (!baseline.empty()) {
+        try {
+            failures += compare_to_baseline(results, baseline, threshold);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
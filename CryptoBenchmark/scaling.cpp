@@ -0,0 +1,354 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sys/resource.h>
+#include "corpus.h"
+#include "perf_counters.h"
+#include "CryptoCaesarCipher/caesar.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+#include "CryptoMatrixSubstitution/matrix_substitution.h"
+#include "CryptoBlockTransposition/block_transposition.h"
+#include "CryptoColumnTransposition/column_transposition.h"
+#include "CryptoZorgeCypher/checkerboard.h"
+
+/**
+ * Thread scalability of the ciphers over shared state: every cipher runs on 1, 2, 4 ... N threads at once
+ * over the same messages, keys, alphabet tables, key caches and autotune calibration, and every output is
+ * compared bit for bit with the single-threaded one. Per cipher and thread count it reports throughput,
+ * speedup and scaling efficiency, plus indicators of why threads slow each other down:
+ *
+ *  slowdown         time per call of a thread relative to the single-threaded run, 1 if threads do not interfere
+ *  waits_per_kcall  voluntary context switches, a thread blocking on a lock someone else holds
+ *  preempted_per_kcall  involuntary context switches, more threads than free cores
+ *  misses_per_kcall cache misses; rising with the thread count at a flat instruction count means cache lines
+ *                   bouncing between cores, shared by the data or falsely by its layout
+ *  instructions_per_call  rising with the thread count means spinning
+ *  imbalance        calls of the busiest thread over those of the idlest one
+ *
+ * The counters come from perf_event_open and are left out where it is not permitted.
+ * Exits with 1 if any output differed from the reference.
+ */
+
+constexpr const uint64_t CORPUS_SEED = 0x5eed;
+
+//the shared messages of one cipher; call(message) ciphers one and returns whether it matched the reference
+struct prepared {
+    std::vector<size_t> message_bytes;
+    std::function<bool(size_t message)> call;
+};
+
+struct scaling_case {
+    std::string cipher;
+    std::function<prepared(size_t symbols, size_t messages)> prepare;
+};
+
+//one cache line per thread, so the harness itself does not share any
+struct alignas(64) thread_stats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t mismatches = 0;
+    double seconds = 0;
+    long waits = 0;
+    long preemptions = 0;
+    bool counted = false;
+    instrumentation::perf_counters::values counters{};
+};
+
+struct scaling_result {
+    std::string cipher;
+    size_t threads;
+    uint64_t calls;
+    uint64_t mismatches;
+    double mb_per_s;
+    double speedup;
+    double efficiency;
+    double slowdown;
+    double waits_per_kcall;
+    double preempted_per_kcall;
+    double imbalance;
+    bool counted;
+    double misses_per_kcall;
+    double instructions_per_call;
+    double ns_per_call;
+};
+
+//computes the references on the calling thread, before any other thread touches the shared state
+template<typename Input, typename Cipher>
+prepared with_references(std::vector<Input> inputs, Cipher cipher) {
+    using Output = decltype(cipher(inputs.front()));
+    auto texts = std::make_shared<const std::vector<Input>>(std::move(inputs));
+    auto references = std::make_shared<std::vector<Output>>();
+    prepared result;
+    for (const auto& text : *texts) {
+        references->push_back(cipher(text));
+        result.message_bytes.push_back(utf8_length(text));
+    }
+    result.call = [texts, references, cipher](size_t message) {
+        return cipher((*texts)[message]) == (*references)[message];
+    };
+    return result;
+}
+
+template<typename Char>
+std::vector<std::basic_string<Char>> make_messages(const Char* alphabet, size_t symbols, size_t messages) {
+    std::vector<std::basic_string<Char>> result;
+    for (size_t i = 0; i < messages; ++i) {
+        result.push_back(corpus_generator(CORPUS_SEED + i).generate(alphabet, symbols));
+    }
+    return result;
+}
+
+std::vector<scaling_case> make_cases() {
+    std::vector<scaling_case> cases;
+
+    cases.push_back({"caesar", [](size_t symbols, size_t messages) {
+        return with_references(make_messages(caesar::all_symbols, symbols, messages), [](const std::wstring& text) {
+            return caesar::do_cipher(text, caesar::Encrypt);
+        });
+    }});
+    //cipher_worker takes messages of up to 300 symbols
+    cases.push_back({"polyalphabetic", [](size_t symbols, size_t messages) {
+        auto texts = make_messages(polyalphabetic::allowed_symbols, std::clamp<size_t>(symbols, 9, 300), messages);
+        return with_references(std::move(texts), [](const std::wstring& text) {
+            return polyalphabetic::cipher_worker<>()(text, polyalphabetic::Encrypt, L"ТАЙНА2024");
+        });
+    }});
+    cases.push_back({"matrix_substitution", [](size_t symbols, size_t messages) {
+        auto texts = make_messages(matrix_substitution::symbols, symbols, messages);
+        return with_references(std::move(texts), [](const std::wstring& text) {
+            return matrix_substitution::encrypt(text, L"ТАЙНА");
+        });
+    }});
+    cases.push_back({"block_transposition", [](size_t symbols, size_t messages) {
+        auto texts = make_messages(block_transposition::symbols, symbols, messages);
+        return with_references(std::move(texts), [](const std::wstring& text) {
+            return block_transposition::encryptor(text, L"ШИФРОВКА").encrypt();
+        });
+    }});
+    cases.push_back({"column_transposition", [](size_t symbols, size_t messages) {
+        auto texts = make_messages(column_transposition::symbols, symbols, messages);
+        return with_references(std::move(texts), [](const std::wstring& text) {
+            return column_transposition::encryptor(text, L"ШИФРОВКА").encrypt();
+        });
+    }});
+    cases.push_back({"zorge", [](size_t symbols, size_t messages) {
+        std::string alphabet = std::string(zorge::symbol_set) + "0123456789";
+        auto enc = std::make_shared<const zorge::encryptor>();
+        return with_references(make_messages(alphabet.c_str(), symbols, messages), [enc](const std::string& text) {
+            return enc->encrypt(text, "SOMBRE");
+        });
+    }});
+
+    return cases;
+}
+
+long context_switches(bool voluntary) {
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    return voluntary ? usage.ru_nvcsw : usage.ru_nivcsw;
+}
+
+/**
+ * Runs the case on threads threads until min_time is over and every thread ciphered each of its messages,
+ * thread i takes messages i, i + threads, ... so together they cover all of them.
+ */
+std::vector<thread_stats> run_threads(const prepared& work, size_t threads, std::chrono::milliseconds min_time) {
+    using clock = std::chrono::steady_clock;
+    const size_t messages = work.message_bytes.size();
+    std::vector<thread_stats> stats(threads);
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<bool> stop{false};
+
+    auto body = [&](size_t thread) {
+        thread_stats& own = stats[thread];
+        auto& counters = instrumentation::perf_counters::for_thread();
+        const uint64_t own_messages = thread < messages ? (messages - thread + threads - 1) / threads : 0;
+        ready.fetch_add(1);
+        while (!go.load()) {
+            std::this_thread::yield();
+        }
+        instrumentation::perf_counters::values before{};
+        bool counting = counters.read(before);
+        long waits = context_switches(true);
+        long preemptions = context_switches(false);
+        auto start = clock::now();
+
+        size_t message = thread % messages;
+        while (!stop.load(std::memory_order_relaxed) || own.calls < own_messages) {
+            own.mismatches += !work.call(message);
+            own.bytes += work.message_bytes[message];
+            ++own.calls;
+            message = (message + threads) % messages;
+        }
+
+        own.seconds = std::chrono::duration<double>(clock::now() - start).count();
+        own.waits = context_switches(true) - waits;
+        own.preemptions = context_switches(false) - preemptions;
+        instrumentation::perf_counters::values after{};
+        own.counted = counting && counters.read(after);
+        for (size_t i = 0; own.counted && i < after.size(); ++i) {
+            own.counters[i] = after[i] - before[i];
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t thread = 0; thread < threads; ++thread) {
+        workers.emplace_back(body, thread);
+    }
+    while (ready.load() != threads) {
+        std::this_thread::yield();
+    }
+    go.store(true);
+    std::this_thread::sleep_for(min_time);
+    stop.store(true);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return stats;
+}
+
+scaling_result summarize(const std::string& cipher, const std::vector<thread_stats>& stats,
+                         const scaling_result* single) {
+    scaling_result result{};
+    result.cipher = cipher;
+    result.threads = stats.size();
+    result.counted = true;
+    uint64_t bytes = 0;
+    uint64_t waits = 0;
+    uint64_t preemptions = 0;
+    uint64_t min_calls = UINT64_MAX;
+    uint64_t max_calls = 0;
+    double wall = 0;
+    double busy = 0;
+    instrumentation::perf_counters::values counters{};
+    for (const auto& own : stats) {
+        result.calls += own.calls;
+        result.mismatches += own.mismatches;
+        bytes += own.bytes;
+        waits += own.waits;
+        preemptions += own.preemptions;
+        min_calls = std::min(min_calls, own.calls);
+        max_calls = std::max(max_calls, own.calls);
+        wall = std::max(wall, own.seconds);
+        busy += own.seconds;
+        result.counted = result.counted && own.counted;
+        for (size_t i = 0; i < counters.size(); ++i) {
+            counters[i] += own.counters[i];
+        }
+    }
+    const double kcalls = double(result.calls) / 1000;
+    result.mb_per_s = double(bytes) / wall / 1e6;
+    result.ns_per_call = busy * 1e9 / double(result.calls);
+    result.waits_per_kcall = double(waits) / kcalls;
+    result.preempted_per_kcall = double(preemptions) / kcalls;
+    result.imbalance = double(max_calls) / double(std::max<uint64_t>(min_calls, 1));
+    if (result.counted) {
+        result.instructions_per_call = double(counters[1]) / double(result.calls);
+        result.misses_per_kcall = double(counters[2]) / kcalls;
+    }
+    const scaling_result& base = single ? *single : result;
+    result.speedup = result.mb_per_s / base.mb_per_s;
+    result.efficiency = result.speedup / double(result.threads);
+    result.slowdown = result.ns_per_call / base.ns_per_call;
+    return result;
+}
+
+std::string to_json(const scaling_result& result) {
+    std::ostringstream out;
+    out << "{\"cipher\":\"" << result.cipher << "\",\"threads\":" << result.threads << ",\"calls\":" << result.calls
+        << ",\"identical\":" << (result.mismatches == 0 ? "true" : "false") << ",\"mismatches\":" << result.mismatches
+        << ",\"mb_per_s\":" << result.mb_per_s << ",\"speedup\":" << result.speedup
+        << ",\"efficiency\":" << result.efficiency << ",\"slowdown\":" << result.slowdown
+        << ",\"waits_per_kcall\":" << result.waits_per_kcall
+        << ",\"preempted_per_kcall\":" << result.preempted_per_kcall << ",\"imbalance\":" << result.imbalance;
+    if (result.counted) {
+        out << ",\"misses_per_kcall\":" << result.misses_per_kcall
+            << ",\"instructions_per_call\":" << result.instructions_per_call;
+    }
+    out << "}";
+    return out.str();
+}
+
+//1, 2, 4 ... up to max_threads, which is always included
+std::vector<size_t> thread_counts(size_t max_threads) {
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(max_threads);
+    return counts;
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoScaling [--threads max] [--symbols 4096] [--messages 64] [--min-time-ms 300]\n"
+                 "                     [--filter cipher]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_threads = std::max(2u, std::thread::hardware_concurrency());
+    size_t symbols = 4096;
+    size_t messages = 64;
+    std::chrono::milliseconds min_time(300);
+    std::string filter;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        if (arg == "--threads") {
+            max_threads = std::stoul(argv[++i]);
+        } else if (arg == "--symbols") {
+            symbols = std::stoul(argv[++i]);
+        } else if (arg == "--messages") {
+            messages = std::stoul(argv[++i]);
+        } else if (arg == "--min-time-ms") {
+            min_time = std::chrono::milliseconds(std::stol(argv[++i]));
+        } else if (arg == "--filter") {
+            filter = argv[++i];
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (max_threads == 0 || symbols == 0 || messages == 0) {
+        print_usage();
+        return 2;
+    }
+
+    uint64_t mismatches = 0;
+    bool first = true;
+    std::cout << "[" << std::endl;
+    for (const auto& scaling : make_cases()) {
+        if (!filter.empty() && scaling.cipher.find(filter) == std::string::npos) {
+            continue;
+        }
+        prepared work = scaling.prepare(symbols, messages);
+        std::unique_ptr<scaling_result> single;
+        for (size_t threads : thread_counts(max_threads)) {
+            scaling_result result = summarize(scaling.cipher, run_threads(work, threads, min_time), single.get());
+            if (!single) {
+                single = std::make_unique<scaling_result>(result);
+            }
+            mismatches += result.mismatches;
+            std::cout << (first ? "" : ",\n") << to_json(result) << std::flush;
+            first = false;
+        }
+    }
+    std::cout << "\n]" << std::endl;
+
+    if (mismatches != 0) {
+        std::cerr << mismatches << " outputs differ from the single-threaded reference" << std::endl;
+        return 1;
+    }
+    return 0;
+}
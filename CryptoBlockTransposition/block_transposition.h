@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <string_view>
+#include <iostream>
+#include <iomanip>
+#include "alphabet.h"
+#include "key_cache.h"
+#include "frequency.h"
+#include "instrumentation.h"
+
+namespace block_transposition {
+
+using symbols_type = alphabets::cyrillic;
+constexpr const auto& symbols = alphabets::cyrillic_traits::symbols;
+
+inline int index_of(const wchar_t& symbol) {
+    return symbols_type::index_of(symbol);
+}
+
+//symbols in the output: the input padded with spaces to a multiple of the key length
+inline size_t encrypted_size(size_t input_size, size_t key_size) {
+    return input_size + (key_size - input_size % key_size) % key_size;
+}
+
+/**
+ * Position of every alphabet symbol among the distinct key symbols in alphabet order,
+ * repeated key symbols share a position. -1 for symbols not in the key.
+ */
+inline std::array<int, symbols_type::size> parse_key_to_indices(std::wstring_view key) {
+    std::array<bool, symbols_type::size> in_key{};
+    for (auto ch : key) {
+        in_key[symbols_type::checked_index_of(ch)] = true;
+    }
+    std::array<int, symbols_type::size> result{};
+    int next = 0;
+    for (size_t i = 0; i < symbols_type::size; ++i) {
+        result[i] = in_key[i] ? next++ : -1;
+    }
+    return result;
+}
+
+using key_schedule = std::array<int, symbols_type::size>;
+
+//parse_key_to_indices of recently used keys, see key_cache.h
+inline key_caches::key_cache<wchar_t, key_schedule>& key_schedules() {
+    static key_caches::key_cache<wchar_t, key_schedule> cache("block_transposition", key_caches::configured_capacity());
+    return cache;
+}
+
+/**
+ * Writes [begin, end) into out block by block, so the input is read once in order and every block is
+ * written while it is in cache. With Checked, symbols outside the alphabet throw illegal_symbol with their
+ * offset from the same loop; otherwise they are passed through.
+ */
+template<bool Checked>
+void transpose_blocks(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out) {
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    const size_t input_size = end - begin;
+    const size_t output_size = encrypted_size(input_size, key.size());
+    key_schedule key_indices = key_schedules().get(key, parse_key_to_indices);
+    if (size_t(*std::max_element(key_indices.begin(), key_indices.end())) + 1 < key.size()) {
+        std::fill_n(out, output_size, L'\0');
+    }
+
+    for (size_t block = 0; block < output_size; block += key.size()) {
+        for (size_t j = 0; j < key.size(); ++j) {
+            size_t position = block + j;
+            wchar_t symbol = L' ';
+            if (position < input_size) {
+                symbol = begin[position];
+                if constexpr (Checked) {
+                    symbols_type::checked_index_of(symbol, position);
+                }
+            }
+            out[block + key_indices[index_of(key[j])]] = symbol;
+        }
+    }
+}
+
+/**
+ * Encrypts [begin, end) into out, which has room for encrypted_size symbols. Does not allocate.
+ * Every block of key length is written in key order; with repeated key symbols the later one wins
+ * and the positions no symbol is written to stay '\0'. Symbols outside the alphabet are passed through.
+ */
+inline void encrypt_into(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out) {
+    INSTRUMENT_STAGE("block_transposition.encrypt", (end - begin) * sizeof(wchar_t));
+    transpose_blocks<false>(begin, end, key, out);
+}
+
+//encrypt_into that throws illegal_symbol for the first symbol outside the alphabet
+inline void checked_encrypt_into(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out) {
+    INSTRUMENT_STAGE("block_transposition.encrypt", (end - begin) * sizeof(wchar_t));
+    transpose_blocks<true>(begin, end, key, out);
+}
+
+/**
+ * Output iterator that block transposes the symbols written through it, for stages that produce their
+ * output one symbol at a time (the Zorge checkerboard codes). Every symbol goes straight to its place in
+ * the current block of out, so the block being filled is the only tile in flight and nothing is buffered.
+ * finish() pads the last block and returns the end of the output; the result equals encrypt_into
+ * over everything written, with the given padding instead of the space.
+ */
+template<typename Symbol>
+class block_writer {
+    //position in the block of every key position
+    std::vector<size_t> targets;
+    bool repeated_symbols;
+    Symbol* block;
+    size_t filled = 0;
+
+    void start_block() {
+        //with repeated key symbols some positions are never written, they stay '\0'
+        if (repeated_symbols) {
+            std::fill_n(block, targets.size(), Symbol{});
+        }
+    }
+
+public:
+    block_writer(std::wstring_view key, Symbol* out) : block(out) {
+        if (key.empty()) {
+            throw std::runtime_error("No key provided");
+        }
+        key_schedule key_indices = key_schedules().get(key, parse_key_to_indices);
+        targets.reserve(key.size());
+        for (auto ch : key) {
+            targets.push_back(key_indices[index_of(ch)]);
+        }
+        repeated_symbols = size_t(*std::max_element(key_indices.begin(), key_indices.end())) + 1 < key.size();
+    }
+
+    block_writer& operator*() {
+        return *this;
+    }
+
+    block_writer& operator++() {
+        return *this;
+    }
+
+    block_writer& operator++(int) {
+        return *this;
+    }
+
+    block_writer& operator=(Symbol symbol) {
+        if (filled == 0) {
+            start_block();
+        }
+        block[targets[filled++]] = symbol;
+        if (filled == targets.size()) {
+            block += filled;
+            filled = 0;
+        }
+        return *this;
+    }
+
+    Symbol* finish(Symbol padding) {
+        while (filled != 0) {
+            *this = padding;
+        }
+        return block;
+    }
+};
+
+class encryptor {
+    std::wstring input;
+    std::wstring key;
+
+public:
+    //the input is validated while it is encrypted, the key when its schedule is parsed
+    encryptor(std::wstring input, std::wstring key) : input(std::move(input)), key(std::move(key)) {}
+
+    std::wstring encrypt() {
+        std::wstring result(key.empty() ? 0 : encrypted_size(input.size(), key.size()), L'\0');
+        checked_encrypt_into(input.data(), input.data() + input.size(), key, &result[0]);
+        return result;
+    }
+
+    static void print_frequency_coefficient(const std::wstring& result) {
+        histogram<symbols_type> frequency;
+        frequency.add(result);
+        double frequency_coeff = frequency.index_of_coincidence();
+        std::cout << std::setprecision(4) << frequency_coeff << std::endl;
+    }
+};
+
+}
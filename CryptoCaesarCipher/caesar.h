@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <stdexcept>
+#include "alphabet.h"
+#include "autotune.h"
+#include "indexed_text.h"
+#include "byte_alphabet.h"
+#include "instrumentation.h"
+
+namespace caesar {
+
+//other alphabets used with this exercise, they need their own traits in alphabet.h:
+// L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ "
+// L"ГЗЛРУЧЬАДИМРФШЮБЕЙНСХЩЯВЖКОТЦЪ "
+using symbols_type = alphabets::cyrillic_latin;
+constexpr const auto& all_symbols = alphabets::cyrillic_latin_traits::symbols;
+
+template<typename Alphabet = symbols_type>
+class encryptor {
+public:
+    wchar_t operator()(const wchar_t& symbol) const {
+        return Alphabet::symbol_at((Alphabet::checked_index_of(symbol) + 3) % Alphabet::size);
+    }
+};
+
+template<typename Alphabet = symbols_type>
+class decryptor {
+public:
+    wchar_t operator()(const wchar_t& symbol) const {
+        return Alphabet::symbol_at((Alphabet::checked_index_of(symbol) + Alphabet::size - 3) % Alphabet::size);
+    }
+};
+
+//symbols are checked by cipher_into in the same pass that ciphers them
+inline void validate_input(const std::wstring& input) {
+    INSTRUMENT_STAGE("caesar.validate", input.size() * sizeof(wchar_t));
+    if (input.length() > 80) {
+        throw std::runtime_error("Illegal plain text length");
+    }
+}
+
+enum Operation { Encrypt = 1, Decrypt };
+
+/**
+ * Ciphers [begin, end) into out, which has room for end - begin symbols; does not allocate.
+ * Validates while ciphering: the first symbol outside the alphabet throws illegal_symbol with its offset.
+ */
+template<typename Alphabet = symbols_type>
+inline void cipher_into(const wchar_t* begin, const wchar_t* end, wchar_t* out, Operation operation) {
+    INSTRUMENT_STAGE("caesar.cipher", (end - begin) * sizeof(wchar_t));
+    const size_t shift = operation == Encrypt ? 3 : Alphabet::size - 3;
+    const size_t length = end - begin;
+    for (size_t offset = 0; offset < length; ++offset) {
+        out[offset] = Alphabet::symbol_at((Alphabet::checked_index_of(begin[offset], offset) + shift) % Alphabet::size);
+    }
+}
+
+/**
+ * Index form of cipher_into, for text decoded with indexed_text: shifts the alphabet indices
+ * [begin, end) into out. The input is valid by construction, so this is a branch-free byte loop.
+ */
+template<typename Alphabet = symbols_type>
+inline void cipher_into(const indexed_text::index_type* begin, const indexed_text::index_type* end,
+                        indexed_text::index_type* out, Operation operation) {
+    INSTRUMENT_STAGE("caesar.cipher_indices", end - begin);
+    const uint8_t shift = operation == Encrypt ? 3 : Alphabet::size - 3;
+    const size_t length = end - begin;
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t shifted = begin[i] + shift;
+        out[i] = shifted >= Alphabet::size ? shifted - Alphabet::size : shifted;
+    }
+}
+
+//byte mode: ciphers raw bytes over the 256 symbol byte_alphabet, no decoding or validation
+inline void cipher_bytes(const uint8_t* begin, const uint8_t* end, uint8_t* out, Operation operation) {
+    INSTRUMENT_STAGE("caesar.cipher_bytes", end - begin);
+    const uint8_t key = 3;
+    byte_alphabet::add_key(begin, end - begin, &key, 1, 0, out, operation == Decrypt);
+}
+
+//cipher_into with the kernel of strategy: the wide loop, the index loop over decoded blocks or that on all cores
+template<typename Alphabet = symbols_type>
+inline void cipher_with(autotune::strategy strategy, const wchar_t* begin, const wchar_t* end, wchar_t* out,
+                        Operation operation) {
+    if (strategy == autotune::SCALAR) {
+        cipher_into<Alphabet>(begin, end, out, operation);
+        return;
+    }
+    autotune::through_indices<Alphabet>(strategy, begin, end, out, [operation](auto in, auto in_end, auto to, size_t) {
+        cipher_into<Alphabet>(in, in_end, to, operation);
+    });
+}
+
+//ciphers with the kernel autotune measured fastest for the size of the input on this machine
+template<typename Alphabet = symbols_type>
+inline std::wstring do_cipher(const std::wstring& input, Operation operation) {
+    autotune::strategy strategy = autotune::choose<Alphabet>(
+        "caesar", input.size(), autotune::all_strategies, [](autotune::strategy kind, auto begin, auto end, auto out) {
+            cipher_with<Alphabet>(kind, begin, end, out, Encrypt);
+        });
+    std::wstring result(input.size(), L'\0');
+    cipher_with<Alphabet>(strategy, input.data(), input.data() + input.size(), &result[0], operation);
+    return result;
+}
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string_view>
+#include <stdexcept>
+#include "alphabet.h"
+#include "compose.h"
+#include "key_cache.h"
+#include "indexed_text.h"
+#include "instrumentation.h"
+
+namespace column_transposition {
+
+using symbols_type = alphabets::cyrillic_digits;
+constexpr const auto& symbols = alphabets::cyrillic_digits_traits::symbols;
+
+inline int index_of(const wchar_t& symbol) {
+    return symbols_type::index_of(symbol);
+}
+
+//symbols in the output: the input padded with spaces to a multiple of the key length
+inline size_t encrypted_size(size_t input_size, size_t key_size) {
+    return input_size + (key_size - input_size % key_size) % key_size;
+}
+
+/**
+ * Output column of every input column: input column r goes to the key position of the r-th key symbol
+ * in alphabet order, equal symbols ranked left to right. One stable sort over the alphabet indices of
+ * the key, so repeated symbols still give every column a place of its own and keys of thousands of
+ * symbols are ordered in O(n log n). Throws illegal_symbol for key symbols outside the alphabet.
+ */
+inline std::vector<uint32_t> parse_key_to_column_indices(std::wstring_view key) {
+    std::vector<uint8_t> ranks(key.size());
+    for (size_t i = 0; i < key.size(); ++i) {
+        ranks[i] = uint8_t(symbols_type::checked_index_of(key[i], i));
+    }
+    std::vector<uint32_t> order(key.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ranks[a] < ranks[b]; });
+    return order;
+}
+
+//shared, so a cache hit does not copy the columns of a long key
+using key_schedule = std::shared_ptr<const std::vector<uint32_t>>;
+
+//parse_key_to_column_indices of recently used keys, see key_cache.h
+inline key_caches::key_cache<wchar_t, key_schedule>& key_schedules() {
+    static key_caches::key_cache<wchar_t, key_schedule> cache("column_transposition", key_caches::configured_capacity());
+    return cache;
+}
+
+inline key_schedule schedule_of(std::wstring_view key) {
+    return key_schedules().get(key, [](std::wstring_view k) {
+        return std::make_shared<const std::vector<uint32_t>>(parse_key_to_column_indices(k));
+    });
+}
+
+//the blocks transpose_rows copies at a time: at least block_rows rows, up to block_budget bytes of short rows,
+//by block_bytes of columns
+constexpr const size_t block_rows = 64;
+constexpr const size_t block_budget = 16 << 10;
+constexpr const size_t block_bytes = 64;
+
+/**
+ * Copies row_count rows of row_length symbols to the output columns: input column c of row r goes to
+ * out[columns[c] * rows + r]. Works through blocks of rows by one cache line of columns, so the lines
+ * read and the runs of every output column written stay in L1 however long the rows are.
+ */
+template<typename Symbol>
+void transpose_rows(const Symbol* in, size_t row_count, size_t row_length, const uint32_t* columns, Symbol* out,
+                    size_t rows) {
+    constexpr size_t block_columns = std::max<size_t>(1, block_bytes / sizeof(Symbol));
+    const size_t rows_per_block = std::max(block_rows, block_budget / (row_length * sizeof(Symbol)));
+    for (size_t first_row = 0; first_row < row_count; first_row += rows_per_block) {
+        const size_t last_row = std::min(row_count, first_row + rows_per_block);
+        for (size_t first_column = 0; first_column < row_length; first_column += block_columns) {
+            const size_t last_column = std::min(row_length, first_column + block_columns);
+            for (size_t column = first_column; column < last_column; ++column) {
+                Symbol* target = out + columns[column] * rows;
+                const Symbol* source = in + column;
+                for (size_t row = first_row; row < last_row; ++row) {
+                    target[row] = source[row * row_length];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Encrypts [begin, end) into out, which has room for encrypted_size symbols. Does not allocate
+ * once the key is cached. The padded input is read as rows of key length and every input column
+ * becomes the output column of its place in parse_key_to_column_indices. Symbol is wchar_t, or the
+ * index type of indexed_text with padding the index of the space.
+ */
+template<typename Symbol>
+void encrypt_into(const Symbol* begin, const Symbol* end, std::wstring_view key, Symbol* out, Symbol padding) {
+    INSTRUMENT_STAGE("column_transposition.encrypt", (end - begin) * sizeof(Symbol));
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    const size_t input_size = end - begin;
+    const size_t row_length = key.size();
+    const size_t rows = encrypted_size(input_size, row_length) / row_length;
+    const size_t full_rows = input_size / row_length;
+    key_schedule columns = schedule_of(key);
+
+    transpose_rows(begin, full_rows, row_length, columns->data(), out, rows);
+    if (full_rows != rows) {
+        const Symbol* last = begin + full_rows * row_length;
+        for (size_t column = 0; column < row_length; ++column) {
+            out[(*columns)[column] * rows + full_rows] = column < input_size % row_length ? last[column] : padding;
+        }
+    }
+}
+
+/**
+ * encrypt_into over the text of a compose view, for the last stage of a chain. The view is read
+ * in tiles of whole rows, about compose::tile_symbols but at least block_rows rows, and every tile
+ * is spread over the output columns before the next one is read, so the stages below run once per
+ * symbol on cached tiles. Allocates the tile.
+ */
+template<typename View>
+void encrypt_view(const View& input, std::wstring_view key, typename View::symbol_type* out,
+                  typename View::symbol_type padding) {
+    using Symbol = typename View::symbol_type;
+    INSTRUMENT_STAGE("column_transposition.encrypt_view", input.size() * sizeof(Symbol));
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    const size_t input_size = input.size();
+    const size_t row_length = key.size();
+    const size_t rows = encrypted_size(input_size, row_length) / row_length;
+    const size_t tile_rows = std::max(block_rows, compose::tile_symbols / row_length);
+    key_schedule columns = schedule_of(key);
+    std::vector<Symbol> tile(tile_rows * row_length);
+
+    for (size_t first_row = 0; first_row < rows; first_row += tile_rows) {
+        const size_t tile_begin = first_row * row_length;
+        const size_t count = std::min(tile.size(), input_size - tile_begin);
+        input.read(tile_begin, count, tile.data());
+        std::fill(tile.begin() + count, tile.end(), padding);
+        const size_t row_count = std::min(tile_rows, rows - first_row);
+        transpose_rows(tile.data(), row_count, row_length, columns->data(), out + first_row, rows);
+    }
+}
+
+inline void encrypt_into(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out) {
+    encrypt_into(begin, end, key, out, L' ');
+}
+
+//the padding of the index form
+constexpr const indexed_text::index_type padding_index = symbols_type::index_of(L' ');
+
+class encryptor {
+    std::wstring input_;
+    std::wstring key;
+
+public:
+    encryptor(std::wstring input, std::wstring key) : input_(std::move(input)), key(std::move(key)) {}
+
+    std::wstring encrypt() {
+        std::wstring result(key.empty() ? 0 : encrypted_size(input_.size(), key.size()), L'\0');
+        encrypt_into(input_.data(), input_.data() + input_.size(), key, &result[0]);
+        return result;
+    }
+};
+
+}
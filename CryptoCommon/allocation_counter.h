@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Counts heap allocations, process-wide and per thread, by replacing the global operator new.
+ * Every replaceable form is covered: plain, array, aligned and nothrow, with the matching deletes.
+ * The replacement functions are defined here, so include it from one translation unit per program only.
+ */
+namespace allocation_counter {
+
+inline std::atomic<size_t> total(0);
+inline thread_local size_t thread_total = 0;
+
+}
+
+//kept out of line: once inlined, GCC pairs new-expressions with the malloc and free inside and reports a mismatch
+#if defined(__GNUC__)
+#define ALLOCATION_COUNTER_OUT_OF_LINE __attribute__((noinline))
+#else
+#define ALLOCATION_COUNTER_OUT_OF_LINE
+#endif
+
+namespace allocation_counter {
+
+ALLOCATION_COUNTER_OUT_OF_LINE inline void* allocate(size_t size, size_t alignment) noexcept {
+    total.fetch_add(1, std::memory_order_relaxed);
+    ++thread_total;
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    //aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE inline void* allocate_or_throw(size_t size, size_t alignment) {
+    if (void* ptr = allocate(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE inline void release(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new(size_t size) {
+    return allocation_counter::allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new[](size_t size) {
+    return allocation_counter::allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new(size_t size, std::align_val_t alignment) {
+    return allocation_counter::allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocation_counter::allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size, alignof(std::max_align_t));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size, alignof(std::max_align_t));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new(size_t size, std::align_val_t alignment,
+                                                  const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size, static_cast<size_t>(alignment));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void* operator new[](size_t size, std::align_val_t alignment,
+                                                    const std::nothrow_t&) noexcept {
+    return allocation_counter::allocate(size, static_cast<size_t>(alignment));
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr, size_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr, size_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr, std::align_val_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr, std::align_val_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    allocation_counter::release(ptr);
+}
+
+ALLOCATION_COUNTER_OUT_OF_LINE void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    allocation_counter::release(ptr);
+}
+
+#undef ALLOCATION_COUNTER_OUT_OF_LINE
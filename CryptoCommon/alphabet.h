@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/**
+ * Thrown by the cipher kernels for the first symbol outside their alphabet, with its offset in the input
+ * and its code point, so validation does not need a pass of its own.
+ */
+class illegal_symbol : public std::runtime_error {
+    size_t offset_;
+    uint32_t code_point_;
+
+    static std::string describe(size_t offset, uint32_t code_point) {
+        char buffer[80];
+        std::snprintf(buffer, sizeof(buffer), "Illegal symbol detected: U+%04X at offset %zu", unsigned(code_point),
+                      offset);
+        return buffer;
+    }
+
+public:
+    illegal_symbol(size_t offset, uint32_t code_point)
+        : std::runtime_error(describe(offset, code_point)), offset_(offset), code_point_(code_point) {}
+
+    [[nodiscard]] size_t offset() const {
+        return offset_;
+    }
+
+    [[nodiscard]] uint32_t code_point() const {
+        return code_point_;
+    }
+};
+
+/**
+ * Compile-time alphabets shared by the exercises.
+ * An alphabet is described by a traits struct holding its symbols as a string literal:
+ *  struct my_traits { static constexpr wchar_t symbols[] = L"..."; };
+ * and alphabet<my_traits> generates the forward (index -> symbol) and the inverse (symbol -> index)
+ * tables at compile time. The inverse table is dense over [0, max symbol], so lookups are a single load,
+ * and size is a constant expression, so "% size" folds into a multiplication.
+ */
+template<typename Traits>
+class alphabet {
+public:
+    using char_type = std::remove_const_t<std::remove_extent_t<decltype(Traits::symbols)>>;
+
+private:
+    static constexpr size_t compute_size() {
+        size_t n = 0;
+        while (Traits::symbols[n] != 0) {
+            ++n;
+        }
+        return n;
+    }
+
+    static constexpr size_t compute_max_symbol() {
+        size_t max = 0;
+        for (size_t i = 0; Traits::symbols[i] != 0; ++i) {
+            if (size_t(Traits::symbols[i]) > max) {
+                max = size_t(Traits::symbols[i]);
+            }
+        }
+        return max;
+    }
+
+public:
+    static constexpr size_t size = compute_size();
+    static constexpr size_t max_symbol = compute_max_symbol();
+
+    static_assert(size > 0 && size < 128, "alphabet indices must fit in a signed byte");
+
+private:
+    static constexpr std::array<char_type, size> make_forward() {
+        std::array<char_type, size> table{};
+        for (size_t i = 0; i < size; ++i) {
+            table[i] = Traits::symbols[i];
+        }
+        return table;
+    }
+
+    //-1 marks symbols outside the alphabet
+    static constexpr std::array<int8_t, max_symbol + 1> make_inverse() {
+        std::array<int8_t, max_symbol + 1> table{};
+        for (auto& entry : table) {
+            entry = -1;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            table[size_t(Traits::symbols[i])] = int8_t(i);
+        }
+        return table;
+    }
+
+public:
+    static constexpr std::array<char_type, size> forward = make_forward();
+    static constexpr std::array<int8_t, max_symbol + 1> inverse = make_inverse();
+
+    static constexpr const char_type* symbols() {
+        return Traits::symbols;
+    }
+
+    static constexpr int index_of(char_type symbol) {
+        auto code = std::make_unsigned_t<char_type>(symbol);
+        return code <= max_symbol ? inverse[code] : -1;
+    }
+
+    static constexpr bool contains(char_type symbol) {
+        return index_of(symbol) != -1;
+    }
+
+    //like unordered_map::at, throws for symbols outside the alphabet
+    static int checked_index_of(char_type symbol) {
+        int index = index_of(symbol);
+        if (index == -1) {
+            throw std::out_of_range("Illegal symbol detected");
+        }
+        return index;
+    }
+
+    //for single pass validate-and-cipher kernels, offset is the position of symbol in the input
+    static int checked_index_of(char_type symbol, size_t offset) {
+        int index = index_of(symbol);
+        if (index == -1) {
+            throw illegal_symbol(offset, std::make_unsigned_t<char_type>(symbol));
+        }
+        return index;
+    }
+
+    static constexpr char_type symbol_at(size_t index) {
+        return forward[index];
+    }
+};
+
+namespace alphabets {
+
+struct cyrillic_traits {
+    static constexpr wchar_t symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ";
+};
+
+struct cyrillic_digits_traits {
+    static constexpr wchar_t symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ 0123456789";
+};
+
+struct cyrillic_latin_traits {
+    static constexpr wchar_t symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯABCDEFGIJKLMNOPQRSTUVWXYZ0123456789 \"-*";
+};
+
+struct direct_substitution_traits {
+    static constexpr wchar_t symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ0123456789 .-#";
+};
+
+struct latin_traits {
+    static constexpr wchar_t symbols[] = L"ABCDEFGHIJKLMNOPQRSTUVWXYZ ";
+};
+
+struct checkerboard_traits {
+    static constexpr char symbols[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ./";
+};
+
+//Block transposition, Matrix substitution
+using cyrillic = alphabet<cyrillic_traits>;
+//Column transposition
+using cyrillic_digits = alphabet<cyrillic_digits_traits>;
+//Caesar, Polyalphabetic substitution
+using cyrillic_latin = alphabet<cyrillic_latin_traits>;
+//Direct substitution
+using direct_substitution = alphabet<direct_substitution_traits>;
+//Solver language models
+using latin = alphabet<latin_traits>;
+//Zorge
+using checkerboard = alphabet<checkerboard_traits>;
+
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "alphabet.h"
+#include "indexed_text.h"
+#include "instrumentation.h"
+#include "parallel_transform.h"
+
+/**
+ * Picks the kernel of a cipher by input size. Short messages are fastest on the scalar wide loop, which has
+ * no setup at all; longer ones on the index kernel, which needs the text decoded to alphabet indices but
+ * then vectorizes; long texts on the index kernel split over all cores, once they are worth the thread startup.
+ *
+ * Where the crossovers lie depends on the machine, so every cipher measures its kernels once on synthetic text
+ * of growing sizes and keeps the sizes from which the vector and the parallel kernel win. The result is cached
+ * in a text file and reused by every later process on the same machine:
+ *
+ *  machine <threads> <cpu model>
+ *  <cipher> <vector from> <parallel from>
+ *  ...
+ *
+ * Inputs below scalar_below symbols always take the scalar kernel; nothing is measured or read until a cipher
+ * first gets a longer one, so interactive messages never pay for the calibration. The cipher names in the file
+ * carry the size and a checksum of the alphabet, an instantiation of a cipher for another alphabet measures anew.
+ *
+ * The file is CRYPTO_AUTOTUNE_FILE, or crypto_autotune.txt in $XDG_CACHE_HOME or ~/.cache; an empty
+ * CRYPTO_AUTOTUNE_FILE measures in every process. A file of another machine is measured over.
+ * CRYPTO_AUTOTUNE=scalar|vector|parallel skips the measurement and always takes that kernel where a cipher has it.
+ */
+namespace autotune {
+
+enum strategy : uint8_t { SCALAR, VECTOR, PARALLEL };
+
+constexpr const std::initializer_list<strategy> all_strategies = {SCALAR, VECTOR, PARALLEL};
+
+constexpr const size_t never = std::numeric_limits<size_t>::max();
+
+//the input sizes in symbols from which the vector and the parallel kernel are faster, never if they are not
+struct crossovers {
+    size_t vector_from = never;
+    size_t parallel_from = never;
+
+    [[nodiscard]] strategy pick(size_t size) const {
+        return size >= parallel_from ? PARALLEL : size >= vector_from ? VECTOR : SCALAR;
+    }
+};
+
+//shorter inputs take the scalar kernel unmeasured, the thread startup or decoding never pays off for them
+constexpr const size_t scalar_below = 1 << 12;
+//sizes measured, from the shortest input that is routed to a file that is worth splitting over many cores
+constexpr const size_t min_sample = scalar_below;
+constexpr const size_t max_sample = 1 << 20;
+//each kernel runs repeatedly for at least this long per size, the fastest of the rounds counts
+constexpr const auto min_round = std::chrono::milliseconds(1);
+constexpr const size_t rounds = 5;
+//threads cost more than their average, a parallel kernel has to win by this factor
+constexpr const double parallel_margin = 0.9;
+//a kernel that won at a smaller size keeps winning at a larger one it loses by less than this factor
+constexpr const double tie_margin = 1.05;
+
+//pseudo random symbols of Alphabet, all valid
+template<typename Alphabet>
+std::wstring sample_text(size_t size) {
+    std::wstring text(size, L'\0');
+    uint32_t state = 0x5eed;
+    for (auto& symbol : text) {
+        state = state * 1664525 + 1013904223;
+        symbol = wchar_t(Alphabet::symbol_at((state >> 16) % Alphabet::size));
+    }
+    return text;
+}
+
+//the cipher name in the file: the alphabet size and an FNV-1a checksum of its symbols
+template<typename Alphabet>
+std::string kernel_name(const char* cipher) {
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 0; i < Alphabet::size; ++i) {
+        checksum = (checksum ^ uint32_t(Alphabet::symbol_at(i))) * 16777619u;
+    }
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%zu.%08x", size_t(Alphabet::size), unsigned(checksum));
+    return cipher + std::string(suffix);
+}
+
+//CRYPTO_AUTOTUNE, read once; empty unless it names a strategy
+inline const std::string& forced_strategy() {
+    static const std::string name = [] {
+        const char* value = std::getenv("CRYPTO_AUTOTUNE");
+        std::string kind = value ? value : "";
+        return kind == "scalar" || kind == "vector" || kind == "parallel" ? kind : std::string();
+    }();
+    return name;
+}
+
+/**
+ * The vector and parallel kernels over wide text: decodes [begin, end) to alphabet indices a block at a time,
+ * kernel(begin, end, out, first) ciphers the indices of the symbols at offset first of the text,
+ * and encodes them into out. Symbols outside the alphabet throw illegal_symbol with their offset in [begin, end),
+ * for PARALLEL the first one of the first failing chunk, as for the scalar kernels.
+ */
+template<typename Alphabet, typename Kernel>
+void through_indices(strategy kind, const wchar_t* begin, const wchar_t* end, wchar_t* out, Kernel kernel) {
+    auto blocks = [&](size_t from, size_t to) {
+        constexpr size_t block = 4096;
+        indexed_text::index_type indices[block];
+        for (size_t offset = from; offset < to; offset += block) {
+            size_t count = std::min(block, to - offset);
+            try {
+                indexed_text::to_indices<Alphabet>(begin + offset, begin + offset + count, indices);
+            } catch (const illegal_symbol& e) {
+                throw illegal_symbol(offset + e.offset(), e.code_point());
+            }
+            kernel(indices, indices + count, indices, offset);
+            indexed_text::to_symbols<Alphabet>(indices, indices + count, out + offset);
+        }
+    };
+    if (kind != PARALLEL) {
+        blocks(0, end - begin);
+        return;
+    }
+    for_each_chunk(chunk_bounds(end - begin, 0), [&](size_t, size_t from, size_t to) { blocks(from, to); });
+}
+
+class calibration {
+    std::mutex mutex;
+    std::string path;
+    std::map<std::string, crossovers> kernels;
+
+    static std::string machine_signature() {
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        for (std::string line; std::getline(cpuinfo, line);) {
+            if (line.compare(0, 10, "model name") == 0) {
+                model = line.substr(line.find(':') + 2);
+                break;
+            }
+        }
+        return "machine " + std::to_string(std::thread::hardware_concurrency()) + " " + model;
+    }
+
+    static std::string default_path() {
+        if (const char* file = std::getenv("CRYPTO_AUTOTUNE_FILE")) {
+            return file;
+        }
+        std::string directory;
+        if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+            directory = cache;
+        } else if (const char* home = std::getenv("HOME"); home && *home) {
+            directory = std::string(home) + "/.cache";
+        } else {
+            return "";
+        }
+        mkdir(directory.c_str(), 0755);
+        return directory + "/crypto_autotune.txt";
+    }
+
+    static std::string format(size_t size) {
+        return size == never ? "never" : std::to_string(size);
+    }
+
+    static size_t parse(const std::string& size) {
+        return size == "never" ? never : std::stoull(size);
+    }
+
+    //kernels of the file, empty if it is missing, unreadable or of another machine
+    std::map<std::string, crossovers> read_file() const {
+        std::map<std::string, crossovers> result;
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line) || line != machine_signature()) {
+            return result;
+        }
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string name, vector_from, parallel_from;
+            if (fields >> name >> vector_from >> parallel_from) {
+                try {
+                    result[name] = {parse(vector_from), parse(parallel_from)};
+                } catch (const std::logic_error&) {
+                    //a damaged line is measured again
+                }
+            }
+        }
+        return result;
+    }
+
+    //merges with what other processes wrote meanwhile and replaces the file in one rename; the cache is an
+    // optimization, a file that cannot be written only means measuring again next time
+    void write_file() {
+        for (const auto& [name, limits] : read_file()) {
+            kernels.emplace(name, limits);
+        }
+        std::string temporary = path + "." + std::to_string(getpid());
+        {
+            std::ofstream out(temporary);
+            out << machine_signature() << "\n";
+            for (const auto& [name, limits] : kernels) {
+                out << name << " " << format(limits.vector_from) << " " << format(limits.parallel_from) << "\n";
+            }
+            if (!out.flush()) {
+                unlink(temporary.c_str());
+                return;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+        }
+    }
+
+    //time per call of every kernel on size symbols, the fastest of rounds interleaved so drift hits all alike
+    template<typename Measure>
+    static std::array<double, 3> fastest_calls(Measure& measure, const std::array<bool, 3>& kinds, size_t size) {
+        using clock = std::chrono::steady_clock;
+        std::array<double, 3> best;
+        best.fill(std::numeric_limits<double>::infinity());
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t kind = 0; kind < kinds.size(); ++kind) {
+                if (!kinds[kind]) {
+                    continue;
+                }
+                size_t calls = 0;
+                auto start = clock::now();
+                auto elapsed = clock::duration::zero();
+                do {
+                    measure(strategy(kind), size);
+                    ++calls;
+                    elapsed = clock::now() - start;
+                } while (elapsed < min_round);
+                best[kind] = std::min(best[kind], std::chrono::duration<double, std::nano>(elapsed).count() / calls);
+            }
+        }
+        return best;
+    }
+
+    /**
+     * A kernel wins from the smallest size at which it is faster and it is no more than tie_margin slower at any
+     * larger size; the largest sizes are bound by memory, where the kernels come out even and noise decides.
+     */
+    template<typename Measure>
+    static crossovers measure_kernels(std::initializer_list<strategy> available, Measure measure) {
+        auto has = [&](strategy kind) { return std::find(available.begin(), available.end(), kind) != available.end(); };
+        const bool parallel = has(PARALLEL) && std::thread::hardware_concurrency() > 1;
+        struct timings {
+            size_t size;
+            std::array<double, 3> ns;
+        };
+        std::vector<timings> sizes;
+        for (size_t size = min_sample; size <= max_sample; size *= 4) {
+            //chunk_bounds never splits less than two chunks' worth, below that PARALLEL runs as VECTOR
+            std::array<bool, 3> kinds = {true, has(VECTOR), parallel && size >= 2 * MIN_PARALLEL_CHUNK};
+            sizes.push_back({size, fastest_calls(measure, kinds, size)});
+        }
+
+        crossovers result;
+        bool vector_holds = true;
+        bool parallel_holds = true;
+        for (auto it = sizes.rbegin(); it != sizes.rend(); ++it) {
+            const auto& ns = it->ns;
+            vector_holds = vector_holds && ns[VECTOR] < ns[SCALAR] * tie_margin;
+            if (vector_holds && ns[VECTOR] < ns[SCALAR]) {
+                result.vector_from = it->size;
+            }
+            double serial_ns = it->size >= result.vector_from ? ns[VECTOR] : ns[SCALAR];
+            parallel_holds = parallel_holds && ns[PARALLEL] < serial_ns * tie_margin;
+            if (parallel_holds && ns[PARALLEL] < serial_ns * parallel_margin) {
+                result.parallel_from = it->size;
+            }
+        }
+        return result;
+    }
+
+    static crossovers forced(strategy kind, std::initializer_list<strategy> available) {
+        auto has = [&](strategy other) { return std::find(available.begin(), available.end(), other) != available.end(); };
+        if (kind == PARALLEL && has(PARALLEL)) {
+            return {never, 0};
+        }
+        if (kind != SCALAR && has(VECTOR)) {
+            return {0, never};
+        }
+        return {};
+    }
+
+public:
+    calibration() : path(default_path()) {
+        if (!path.empty()) {
+            kernels = read_file();
+        }
+    }
+
+    static calibration& machine() {
+        static calibration instance;
+        return instance;
+    }
+
+    /**
+     * The crossovers of kernel, from the file or measured now. measure(strategy, size) runs the kernel
+     * once on size symbols; available lists the strategies the kernel has, SCALAR always among them.
+     */
+    template<typename Measure>
+    crossovers get(const std::string& kernel, std::initializer_list<strategy> available, Measure measure) {
+        if (const std::string& kind = forced_strategy(); !kind.empty()) {
+            return forced(kind == "scalar" ? SCALAR : kind == "vector" ? VECTOR : PARALLEL, available);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto known = kernels.find(kernel); known != kernels.end()) {
+            return known->second;
+        }
+        INSTRUMENT_PAUSE();
+        crossovers result = measure_kernels(available, measure);
+        kernels[kernel] = result;
+        if (!path.empty()) {
+            write_file();
+        }
+        return result;
+    }
+};
+
+//the crossovers of a cipher over wide text of Alphabet, run(strategy, begin, end, out) ciphers with its kernels
+template<typename Alphabet, typename Run>
+crossovers calibrate(const char* cipher, std::initializer_list<strategy> available, Run run) {
+    std::wstring input;
+    std::wstring output;
+    return calibration::machine().get(kernel_name<Alphabet>(cipher), available, [&](strategy kind, size_t size) {
+        if (input.size() < size) {
+            input = sample_text<Alphabet>(size);
+            output.assign(size, L'\0');
+        }
+        run(kind, input.data(), input.data() + size, &output[0]);
+    });
+}
+
+/**
+ * The kernel of a cipher for an input of size symbols; run as for calibrate. Every call site keeps its
+ * crossovers in a static of its own, so a process measures or reads each cipher once, on its first input
+ * of scalar_below symbols or more.
+ */
+template<typename Alphabet, typename Run>
+strategy choose(const char* cipher, size_t size, std::initializer_list<strategy> available, Run run) {
+    if (size < scalar_below && forced_strategy().empty()) {
+        return SCALAR;
+    }
+    static const crossovers limits = calibrate<Alphabet>(cipher, available, run);
+    return limits.pick(size);
+}
+
+}
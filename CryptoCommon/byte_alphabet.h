@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/**
+ * The 256 symbol alphabet of raw bytes, for ciphering arbitrary files. Every byte is a symbol and its own
+ * index, so there is nothing to decode or validate, and arithmetic modulo the alphabet size is the
+ * wrap-around of uint8_t: the shift ciphers reduce to a byte-wise add or subtract of a key stream.
+ */
+namespace byte_alphabet {
+
+constexpr const size_t size = 256;
+
+/**
+ * out[i] = in[i] + stream[i], or - with subtract, for i < length. in and out may be the same buffer.
+ * 32 bytes per step with AVX2, 16 with SSE2, the rest one by one.
+ */
+inline void add_stream(const uint8_t* in, const uint8_t* stream, uint8_t* out, size_t length, bool subtract) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 32 <= length; i += 32) {
+        __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stream + i));
+        data = subtract ? _mm256_sub_epi8(data, key) : _mm256_add_epi8(data, key);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), data);
+    }
+#endif
+#ifdef __SSE2__
+    for (; i + 16 <= length; i += 16) {
+        __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stream + i));
+        data = subtract ? _mm_sub_epi8(data, key) : _mm_add_epi8(data, key);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), data);
+    }
+#endif
+    for (; i < length; ++i) {
+        out[i] = subtract ? uint8_t(in[i] - stream[i]) : uint8_t(in[i] + stream[i]);
+    }
+}
+
+/**
+ * Adds (or subtracts) the key repeated over the whole input, starting at key position key_offset % key_size.
+ * Short keys are first repeated into a stack buffer of at least min_stream bytes, so every add_stream call
+ * covers enough bytes to run on full vectors; longer keys are used as the stream directly.
+ */
+inline void add_key(const uint8_t* in, size_t length, const uint8_t* key, size_t key_size, size_t key_offset,
+                    uint8_t* out, bool subtract) {
+    constexpr size_t min_stream = 256;
+    uint8_t repeated[2 * min_stream];
+    const uint8_t* stream = key;
+    size_t period = key_size;
+    if (key_size < min_stream) {
+        period = (min_stream + key_size - 1) / key_size * key_size;
+        for (size_t j = 0; j < period; ++j) {
+            repeated[j] = key[j % key_size];
+        }
+        stream = repeated;
+    }
+
+    //the first, partial period from key_offset to the end of the stream
+    size_t start = key_offset % key_size;
+    size_t done = period - start < length ? period - start : length;
+    add_stream(in, stream + start, out, done, subtract);
+    while (done < length) {
+        size_t count = length - done < period ? length - done : period;
+        add_stream(in + done, stream, out + done, count, subtract);
+        done += count;
+    }
+}
+
+}
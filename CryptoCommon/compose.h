@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+/**
+ * Lazy views for chaining ciphers without materializing every stage.
+ *
+ * A view is the text after some stages: size() and read(first, count, out), which evaluates the symbols
+ * [first, first + count) into out. Substitution stages are map views, they read the range from the view below
+ * and cipher it in place, so a chain of them makes one pass over a range instead of one pass per stage.
+ * A transposition at the end of the chain reads the view tile by tile, tile_symbols at a time, and moves
+ * every tile to its places in the output while it is still in the cache (see column_transposition::encrypt_view):
+ * the whole chain reads the input once and writes the output once.
+ *
+ * Views are cheap to copy: they refer to the text they start from, which has to outlive them.
+ * Stages whose output length is not known per position, like the Zorge checkerboard codes, are not views;
+ * they write through an output iterator instead, see block_transposition::block_writer.
+ */
+namespace compose {
+
+//symbols a transposition reads from a view at once, small enough to stay in the first level cache
+constexpr const size_t tile_symbols = 4096;
+
+//[begin, end) as the first stage of a chain
+template<typename Symbol>
+class span_view {
+    const Symbol* begin;
+    size_t length;
+
+public:
+    using symbol_type = Symbol;
+
+    span_view(const Symbol* begin, const Symbol* end) : begin(begin), length(end - begin) {}
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+
+    void read(size_t first, size_t count, Symbol* out) const {
+        std::copy(begin + first, begin + first + count, out);
+    }
+};
+
+//the view after left padding symbols, followed by padding symbols up to total symbols
+template<typename View>
+class padded_view {
+    using Symbol = typename View::symbol_type;
+
+    View base;
+    size_t left;
+    size_t total;
+    Symbol padding;
+
+public:
+    using symbol_type = Symbol;
+
+    padded_view(View base, size_t left, size_t total, Symbol padding)
+        : base(std::move(base)), left(left), total(total), padding(padding) {}
+
+    [[nodiscard]] size_t size() const {
+        return total;
+    }
+
+    void read(size_t first, size_t count, Symbol* out) const {
+        const size_t last = first + count;
+        const size_t inner_begin = std::clamp(left, first, last);
+        const size_t inner_end = std::clamp(left + base.size(), first, last);
+        std::fill(out, out + (inner_begin - first), padding);
+        if (inner_begin != inner_end) {
+            base.read(inner_begin - left, inner_end - inner_begin, out + (inner_begin - first));
+        }
+        std::fill(out + (inner_end - first), out + count, padding);
+    }
+};
+
+/**
+ * The view with a substitution stage applied: function(symbols, count, first) ciphers in place the count
+ * symbols starting at position first of the text. Ranges are read in any order, so the stage must not
+ * depend on the symbols before first.
+ */
+template<typename View, typename Function>
+class map_view {
+    using Symbol = typename View::symbol_type;
+
+    View base;
+    Function function;
+
+public:
+    using symbol_type = Symbol;
+
+    map_view(View base, Function function) : base(std::move(base)), function(std::move(function)) {}
+
+    [[nodiscard]] size_t size() const {
+        return base.size();
+    }
+
+    void read(size_t first, size_t count, Symbol* out) const {
+        base.read(first, count, out);
+        function(out, count, first);
+    }
+};
+
+template<typename View>
+padded_view<View> pad(View base, size_t left, size_t total, typename View::symbol_type padding) {
+    return padded_view<View>(std::move(base), left, total, padding);
+}
+
+template<typename View, typename Function>
+map_view<View, Function> map(View base, Function function) {
+    return map_view<View, Function>(std::move(base), std::move(function));
+}
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+/**
+ * Deterministic corpus generator.
+ * The alphabet is split into letters, digits and everything else (space, punctuation)
+ * and symbols are drawn 70/15/15 from the three classes, so every exercise gets text
+ * that looks roughly like its own input. The same seed always gives the same corpus.
+ */
+class corpus_generator {
+    uint64_t state;
+
+    uint64_t next() {
+        //splitmix64
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    template<typename Char>
+    static bool is_letter(Char ch) {
+        return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch >= 0x400;
+    }
+
+    template<typename Char>
+    static bool is_digit(Char ch) {
+        return ch >= '0' && ch <= '9';
+    }
+
+public:
+    explicit corpus_generator(uint64_t seed) : state(seed) {}
+
+    template<typename Char>
+    std::basic_string<Char> generate(const Char* alphabet, size_t alphabet_size, size_t length) {
+        std::vector<Char> classes[3];
+        for (size_t i = 0; i < alphabet_size; ++i) {
+            Char ch = alphabet[i];
+            classes[is_letter(ch) ? 0 : is_digit(ch) ? 1 : 2].push_back(ch);
+        }
+        const unsigned weights[3] = {70, 15, 15};
+
+        std::basic_string<Char> result;
+        result.reserve(length);
+        while (result.size() < length) {
+            uint64_t value = next();
+            unsigned roll = value % 100;
+            int cls = roll < weights[0] ? 0 : roll < weights[0] + weights[1] ? 1 : 2;
+            if (classes[cls].empty()) {
+                cls = 0;
+            }
+            result.push_back(classes[cls][(value >> 32) % classes[cls].size()]);
+        }
+        return result;
+    }
+
+    std::wstring generate(const wchar_t* alphabet, size_t length) {
+        return generate(alphabet, wcslen(alphabet), length);
+    }
+
+    std::string generate(const char* alphabet, size_t length) {
+        return generate(alphabet, strlen(alphabet), length);
+    }
+};
+
+inline size_t utf8_length(const std::wstring& text) {
+    size_t bytes = 0;
+    for (wchar_t ch : text) {
+        bytes += ch < 0x80 ? 1 : ch < 0x800 ? 2 : ch < 0x10000 ? 3 : 4;
+    }
+    return bytes;
+}
+
+inline size_t utf8_length(const std::string& text) {
+    return text.size();
+}
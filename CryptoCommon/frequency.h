@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include "parallel_transform.h"
+
+/**
+ * Symbol counts over a compile-time alphabet, stored densely by alphabet index.
+ * Symbols outside the alphabet are counted separately and do not take part in the
+ * index of coincidence.
+ */
+template<typename Alphabet>
+class histogram {
+public:
+    using char_type = typename Alphabet::char_type;
+
+private:
+    //one extra bucket for symbols outside the alphabet
+    static constexpr size_t buckets = Alphabet::size + 1;
+    //independent sub-histograms, so consecutive equal symbols do not wait on each other's store
+    static constexpr size_t lanes = 4;
+
+    std::array<uint64_t, buckets> counts{};
+
+    static size_t bucket_of(char_type symbol) {
+        return std::min<size_t>(unsigned(Alphabet::index_of(symbol)), Alphabet::size);
+    }
+
+public:
+    void add(const char_type* begin, const char_type* end) {
+        uint64_t sub[lanes][buckets] = {};
+        const char_type* it = begin;
+        for (; end - it >= ptrdiff_t(lanes); it += lanes) {
+            ++sub[0][bucket_of(it[0])];
+            ++sub[1][bucket_of(it[1])];
+            ++sub[2][bucket_of(it[2])];
+            ++sub[3][bucket_of(it[3])];
+        }
+        for (; it != end; ++it) {
+            ++sub[0][bucket_of(*it)];
+        }
+        for (size_t bucket = 0; bucket < buckets; ++bucket) {
+            counts[bucket] += sub[0][bucket] + sub[1][bucket] + sub[2][bucket] + sub[3][bucket];
+        }
+    }
+
+    void add(const std::basic_string<char_type>& text) {
+        add(text.data(), text.data() + text.size());
+    }
+
+    void merge(const histogram& other) {
+        for (size_t bucket = 0; bucket < buckets; ++bucket) {
+            counts[bucket] += other.counts[bucket];
+        }
+    }
+
+    [[nodiscard]] uint64_t count(char_type symbol) const {
+        return counts[bucket_of(symbol)];
+    }
+
+    //symbols of the alphabet only
+    [[nodiscard]] uint64_t total() const {
+        uint64_t sum = 0;
+        for (size_t index = 0; index < Alphabet::size; ++index) {
+            sum += counts[index];
+        }
+        return sum;
+    }
+
+    [[nodiscard]] uint64_t ignored() const {
+        return counts[Alphabet::size];
+    }
+
+    /**
+     * IC = sum(n_i * (n_i - 1)) / (N * (N - 1))
+     * The sum is kept in 64 bits and the denominator in floating point, so it holds for any input size.
+     */
+    [[nodiscard]] double index_of_coincidence() const {
+        uint64_t n = total();
+        if (n < 2) {
+            return 0;
+        }
+        uint64_t sum = 0;
+        for (size_t index = 0; index < Alphabet::size; ++index) {
+            sum += counts[index] == 0 ? 0 : counts[index] * (counts[index] - 1);
+        }
+        return double(sum) / (double(n) * double(n - 1));
+    }
+
+    //counts every chunk on its own thread and merges the per-thread histograms
+    static histogram parallel(const std::basic_string<char_type>& text, size_t threads = 0) {
+        std::vector<size_t> bounds = chunk_bounds(text.size(), threads);
+        std::vector<histogram> partial(bounds.size() - 1);
+        for_each_chunk(bounds, [&](size_t chunk, size_t begin, size_t end) {
+            partial[chunk].add(text.data() + begin, text.data() + end);
+        });
+        histogram result;
+        for (const auto& part : partial) {
+            result.merge(part);
+        }
+        return result;
+    }
+};
+
+/**
+ * Index of coincidence over the last `window` alphabet symbols of a stream, updated in O(1) per symbol.
+ * Adding a symbol with count c raises the sum by 2c, dropping one with count c lowers it by 2(c - 1).
+ * Symbols outside the alphabet are skipped.
+ */
+template<typename Alphabet>
+class sliding_coincidence {
+public:
+    using char_type = typename Alphabet::char_type;
+
+private:
+    std::vector<uint8_t> ring;
+    size_t head = 0;
+    size_t filled = 0;
+    std::array<uint64_t, Alphabet::size> counts{};
+    uint64_t sum = 0;
+
+public:
+    explicit sliding_coincidence(size_t window) : ring(std::max<size_t>(window, 2)) {}
+
+    //returns false if the symbol is outside the alphabet and was skipped
+    bool push(char_type symbol) {
+        int index = Alphabet::index_of(symbol);
+        if (index == -1) {
+            return false;
+        }
+        if (filled == ring.size()) {
+            uint8_t oldest = ring[head];
+            sum -= 2 * (counts[oldest] - 1);
+            --counts[oldest];
+        } else {
+            ++filled;
+        }
+        sum += 2 * counts[index];
+        ++counts[index];
+        ring[head] = uint8_t(index);
+        head = head + 1 == ring.size() ? 0 : head + 1;
+        return true;
+    }
+
+    [[nodiscard]] bool full() const {
+        return filled == ring.size();
+    }
+
+    [[nodiscard]] double value() const {
+        if (filled < 2) {
+            return 0;
+        }
+        return double(sum) / (double(filled) * double(filled - 1));
+    }
+
+    /**
+     * Single pass over text calling report(offset, ic) for every full window, offset being the
+     * position just past the window's last symbol.
+     */
+    template<typename Report>
+    static void scan(const char_type* begin, const char_type* end, size_t window, Report report) {
+        sliding_coincidence coincidence(window);
+        for (const char_type* it = begin; it != end; ++it) {
+            if (coincidence.push(*it) && coincidence.full()) {
+                report(size_t(it + 1 - begin), coincidence.value());
+            }
+        }
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "alphabet.h"
+#include "utf8.h"
+
+/**
+ * Text as one byte alphabet indices instead of 4 byte wchar_t symbols, for kernels that only ever
+ * look at the position of a symbol in its alphabet (shift, Vigenère, substitution codes, transposition).
+ * UTF-8 is decoded straight into indices and indices are encoded straight back to UTF-8,
+ * so the wide form is never materialized. Indices are 0 .. Alphabet::size - 1, every alphabet fits a byte.
+ */
+namespace indexed_text {
+
+using index_type = uint8_t;
+
+//the UTF-8 form of every alphabet symbol, padded to 4 bytes so encoding copies a fixed size
+template<typename Alphabet>
+struct utf8_symbols {
+    struct entry {
+        std::array<char, 4> bytes;
+        size_t length;
+    };
+
+    static std::array<entry, Alphabet::size> make() {
+        std::array<entry, Alphabet::size> table{};
+        for (size_t i = 0; i < Alphabet::size; ++i) {
+            char* end = utf8::encode_symbol(uint32_t(Alphabet::symbol_at(i)), table[i].bytes.data());
+            table[i].length = end - table[i].bytes.data();
+        }
+        return table;
+    }
+
+    static inline const std::array<entry, Alphabet::size> table = make();
+};
+
+/**
+ * Decodes UTF-8 [begin, end) into the indices of its symbols, validating both in one pass.
+ * out needs room for utf8::max_decoded(end - begin) indices; returns the indices written.
+ * Throws illegal_symbol with the symbol offset for symbols outside the alphabet.
+ */
+template<typename Alphabet>
+size_t decode(const char* begin, const char* end, index_type* out) {
+    index_type* const first = out;
+    const char* it = begin;
+    while (it != end) {
+        uint32_t symbol = uint8_t(*it) < 0x80 ? uint8_t(*it++) : utf8::decode_symbol(it, end);
+        size_t offset = out - first;
+        if (symbol > Alphabet::max_symbol) {
+            throw illegal_symbol(offset, symbol);
+        }
+        *out++ = index_type(Alphabet::checked_index_of(typename Alphabet::char_type(symbol), offset));
+    }
+    return out - first;
+}
+
+//encodes the indices [begin, end) as UTF-8 into out, which needs room for utf8::max_encoded(end - begin) bytes
+template<typename Alphabet>
+size_t encode(const index_type* begin, const index_type* end, char* out) {
+    const auto& table = utf8_symbols<Alphabet>::table;
+    char* const first = out;
+    for (const index_type* it = begin; it != end; ++it) {
+        const auto& symbol = table[*it];
+        std::memcpy(out, symbol.bytes.data(), 4);
+        out += symbol.length;
+    }
+    return out - first;
+}
+
+//wide symbols to indices and back, for callers that already hold the text as wchar_t
+template<typename Alphabet>
+void to_indices(const wchar_t* begin, const wchar_t* end, index_type* out) {
+    const size_t length = end - begin;
+    for (size_t offset = 0; offset < length; ++offset) {
+        out[offset] = index_type(Alphabet::checked_index_of(begin[offset], offset));
+    }
+}
+
+template<typename Alphabet>
+void to_symbols(const index_type* begin, const index_type* end, wchar_t* out) {
+    std::transform(begin, end, out, [](index_type index) { return Alphabet::symbol_at(index); });
+}
+
+}
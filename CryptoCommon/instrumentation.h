@@ -0,0 +1,198 @@
+#pragma once
+
+/**
+ * Per-stage instrumentation of the hot paths, compiled in with -DCRYPTO_INSTRUMENTATION
+ * (cmake -DCRYPTO_INSTRUMENTATION=ON) and compiled out to nothing otherwise.
+ *
+ *  INSTRUMENT_STAGE("caesar.cipher", input.size() * sizeof(wchar_t));
+ *
+ * times the rest of the enclosing scope and adds the call, its duration, the given byte count and the
+ * allocations made on this thread to the named stage. Stages nest, every stage reports its inclusive time.
+ * Where perf_event_open is permitted, user-space cycles, instructions and cache misses are added as well.
+ *
+ * The report is one JSON object per stage, written on exit, on SIGUSR1 (the program keeps running)
+ * and on SIGINT/SIGTERM (the program exits afterwards), to the file named by CRYPTO_INSTRUMENTATION_REPORT
+ * or to stderr.
+ */
+#ifdef CRYPTO_INSTRUMENTATION
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <unistd.h>
+#include "allocation_counter.h"
+#include "perf_counters.h"
+
+namespace instrumentation {
+
+struct stage {
+    const char* const name;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> ns{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> counted_calls{0};
+    std::array<std::atomic<uint64_t>, perf_counters::count> counters{};
+
+    explicit stage(const char* name) : name(name) {}
+};
+
+class registry {
+    mutable std::mutex mutex;
+    //deque, so handed out references stay valid while stages are added
+    std::deque<stage> stages;
+
+public:
+    static registry& instance() {
+        static registry stages;
+        return stages;
+    }
+
+    //called once per instrumented site, the site keeps the reference
+    stage& get(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& existing : stages) {
+            if (std::strcmp(existing.name, name) == 0) {
+                return existing;
+            }
+        }
+        return stages.emplace_back(name);
+    }
+
+    void report(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "[\n";
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const stage& s = stages[i];
+            out << "{\"stage\":\"" << s.name << "\",\"calls\":" << s.calls << ",\"total_ns\":" << s.ns
+                << ",\"bytes\":" << s.bytes << ",\"allocations\":" << s.allocations;
+            if (s.counted_calls != 0) {
+                out << ",\"counted_calls\":" << s.counted_calls << ",\"cycles\":" << s.counters[0]
+                    << ",\"instructions\":" << s.counters[1] << ",\"cache_misses\":" << s.counters[2];
+            }
+            out << "}" << (i + 1 == stages.size() ? "\n" : ",\n");
+        }
+        out << "]" << std::endl;
+    }
+
+    void dump() const {
+        if (const char* path = std::getenv("CRYPTO_INSTRUMENTATION_REPORT")) {
+            std::ofstream out(path, std::ios::trunc);
+            report(out);
+        } else {
+            report(std::cerr);
+        }
+    }
+};
+
+//nonzero while autotune.h calibrates; the synthetic calls of a calibration are not charged to the stages
+inline std::atomic<int> paused{0};
+
+class scoped_pause {
+public:
+    scoped_pause() {
+        paused.fetch_add(1);
+    }
+
+    scoped_pause(const scoped_pause&) = delete;
+    scoped_pause& operator=(const scoped_pause&) = delete;
+
+    ~scoped_pause() {
+        paused.fetch_sub(1);
+    }
+};
+
+class scoped_timer {
+    stage& target;
+    const uint64_t bytes;
+    const size_t allocations = allocation_counter::thread_total;
+    perf_counters::values counters_before{};
+    const bool counting = perf_counters::for_thread().read(counters_before);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+    scoped_timer(stage& target, uint64_t bytes) : target(target), bytes(bytes) {}
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+    ~scoped_timer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        perf_counters::values counters_after{};
+        bool counted = counting && perf_counters::for_thread().read(counters_after);
+        if (paused.load(std::memory_order_relaxed) != 0) {
+            return;
+        }
+
+        target.calls.fetch_add(1, std::memory_order_relaxed);
+        target.ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                            std::memory_order_relaxed);
+        target.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        target.allocations.fetch_add(allocation_counter::thread_total - allocations, std::memory_order_relaxed);
+        if (counted) {
+            target.counted_calls.fetch_add(1, std::memory_order_relaxed);
+            for (size_t i = 0; i < perf_counters::count; ++i) {
+                target.counters[i].fetch_add(counters_after[i] - counters_before[i], std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+/**
+ * Writes the report at exit and from a dedicated thread waiting for the report signals.
+ * The signals are blocked before main, so every thread the program starts inherits the mask
+ * and only the reporter thread receives them.
+ */
+inline bool report_on_exit_and_signal() {
+    registry::instance();
+    std::atexit([]() { registry::instance().dump(); });
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::thread([signals]() {
+        int signal;
+        while (sigwait(&signals, &signal) == 0) {
+            registry::instance().dump();
+            if (signal != SIGUSR1) {
+                std::_Exit(128 + signal);
+            }
+        }
+    }).detach();
+    return true;
+}
+
+inline const bool reporter_installed = report_on_exit_and_signal();
+
+}
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+#define INSTRUMENT_STAGE(name, bytes)                                                                      \
+    static instrumentation::stage& INSTRUMENT_CONCAT(instrumented_stage_, __LINE__) =                      \
+            instrumentation::registry::instance().get(name);                                               \
+    instrumentation::scoped_timer INSTRUMENT_CONCAT(instrumented_timer_, __LINE__)(                        \
+            INSTRUMENT_CONCAT(instrumented_stage_, __LINE__), bytes)
+//no stage records calls on any thread until the end of the enclosing scope
+#define INSTRUMENT_PAUSE() instrumentation::scoped_pause INSTRUMENT_CONCAT(instrumentation_pause_, __LINE__)
+
+#else
+
+#define INSTRUMENT_STAGE(name, bytes) static_cast<void>(0)
+#define INSTRUMENT_PAUSE() static_cast<void>(0)
+
+#endif
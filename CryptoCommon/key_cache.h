@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Bounded cache of prepared key schedules (block and column key ranks, Zorge checkerboards),
+ * one per cipher, so a key reused across many messages is prepared once.
+ *
+ * Lookups take a shared lock and copy the schedule out, so a hit neither allocates nor blocks other
+ * readers. Recency is approximated CLOCK style: a hit sets the entry's referenced flag, and a miss that finds
+ * the cache full sweeps a hand over the entries, evicting the first one not referenced since the last sweep.
+ * The schedule of a miss is built outside the lock and inserted under the exclusive lock.
+ * Builders that throw (invalid keys) leave the cache unchanged.
+ */
+namespace key_caches {
+
+struct statistics {
+    const char* name;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t size;
+    size_t capacity;
+};
+
+//the caches of the program, for reporting
+class registry {
+    std::mutex mutex;
+    std::vector<std::function<statistics()>> sources;
+
+public:
+    static registry& instance() {
+        static registry caches;
+        return caches;
+    }
+
+    void add(std::function<statistics()> source) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sources.push_back(std::move(source));
+    }
+
+    //one JSON object per cache
+    void report(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "[\n";
+        for (size_t i = 0; i < sources.size(); ++i) {
+            statistics s = sources[i]();
+            out << "{\"cache\":\"" << s.name << "\",\"hits\":" << s.hits << ",\"misses\":" << s.misses
+                << ",\"evictions\":" << s.evictions << ",\"size\":" << s.size << ",\"capacity\":" << s.capacity
+                << "}" << (i + 1 == sources.size() ? "\n" : ",\n");
+        }
+        out << "]" << std::endl;
+    }
+};
+
+constexpr const size_t default_capacity = 1024;
+
+//CRYPTO_KEY_CACHE_CAPACITY overrides the default, 0 disables caching
+inline size_t configured_capacity() {
+    const char* value = std::getenv("CRYPTO_KEY_CACHE_CAPACITY");
+    return value ? std::strtoul(value, nullptr, 10) : default_capacity;
+}
+
+template<typename Char, typename Schedule>
+class key_cache {
+    struct slot {
+        std::basic_string<Char> key;
+        Schedule schedule{};
+        std::atomic<bool> referenced{false};
+        bool used = false;
+    };
+
+    const char* const name;
+    std::vector<slot> slots;
+    std::unordered_multimap<size_t, size_t> by_hash;
+    mutable std::shared_mutex mutex;
+    size_t hand = 0;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    static size_t hash_of(std::basic_string_view<Char> key) {
+        return std::hash<std::basic_string_view<Char>>()(key);
+    }
+
+    //slot holding key, -1 if there is none; the caller holds the lock
+    long find(std::basic_string_view<Char> key, size_t hash) const {
+        auto range = by_hash.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (slots[it->second].key == key) {
+                return long(it->second);
+            }
+        }
+        return -1;
+    }
+
+    //an unused slot or the first one the hand finds unreferenced; the caller holds the exclusive lock
+    size_t victim() {
+        while (true) {
+            size_t index = hand;
+            hand = (hand + 1) % slots.size();
+            slot& candidate = slots[index];
+            if (!candidate.used || !candidate.referenced.exchange(false, std::memory_order_relaxed)) {
+                return index;
+            }
+        }
+    }
+
+public:
+    key_cache(const char* name, size_t capacity) : name(name), slots(capacity) {
+        by_hash.reserve(capacity);
+        registry::instance().add([this]() { return stats(); });
+    }
+
+    key_cache(const key_cache&) = delete;
+    key_cache& operator=(const key_cache&) = delete;
+
+    //the schedule of key, built with build(key) unless cached
+    template<typename Build>
+    Schedule get(std::basic_string_view<Char> key, Build build) {
+        const size_t hash = hash_of(key);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            long index = find(key, hash);
+            if (index != -1) {
+                slot& cached = slots[index];
+                //checked first, so hits on a hot entry do not keep writing its cache line
+                if (!cached.referenced.load(std::memory_order_relaxed)) {
+                    cached.referenced.store(true, std::memory_order_relaxed);
+                }
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return cached.schedule;
+            }
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        Schedule schedule = build(key);
+        if (slots.empty()) {
+            return schedule;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (find(key, hash) != -1) {
+            return schedule;
+        }
+        size_t index = victim();
+        slot& target = slots[index];
+        if (target.used) {
+            evictions.fetch_add(1, std::memory_order_relaxed);
+            auto range = by_hash.equal_range(hash_of(target.key));
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == index) {
+                    by_hash.erase(it);
+                    break;
+                }
+            }
+        }
+        target.key.assign(key.data(), key.size());
+        target.schedule = schedule;
+        target.referenced.store(false, std::memory_order_relaxed);
+        target.used = true;
+        by_hash.emplace(hash, index);
+        return schedule;
+    }
+
+    [[nodiscard]] statistics stats() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return {name, hits.load(), misses.load(), evictions.load(), by_hash.size(), slots.size()};
+    }
+};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//a whole file mapped read-only, unmapped with the object; empty files map to an empty range
+class mapped_file {
+    void* address = nullptr;
+    size_t length = 0;
+
+public:
+    explicit mapped_file(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat status{};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path);
+        }
+        length = size_t(status.st_size);
+        if (length != 0) {
+            address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+            throw std::runtime_error("Cannot map " + path);
+        }
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file() {
+        if (address != nullptr) {
+            ::munmap(address, length);
+        }
+    }
+
+    //the file is read once front to back, lets the kernel read ahead further
+    void advise_sequential() const {
+        if (address != nullptr) {
+            ::madvise(address, length, MADV_SEQUENTIAL);
+        }
+    }
+
+    [[nodiscard]] const char* data() const {
+        return static_cast<const char*>(address);
+    }
+
+    [[nodiscard]] size_t size() const {
+        return length;
+    }
+};
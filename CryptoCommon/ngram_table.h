@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "mapped_file.h"
+
+/**
+ * Flat binary n-gram scoring tables over one alphabet, built by CryptoNgrams from text corpora and mapped
+ * read-only by the analysis code, which indexes them in place without parsing anything at startup.
+ * All fields are little-endian, the byte order of the hosts building and reading them:
+ *
+ *  header    [magic: 8 "CRNGRAM1"][alphabet size: 4][max order: 4][symbols: 8][offset of orders 1..4: 8 each]
+ *  alphabet  [code point: 4] per alphabet symbol, in alphabet order
+ *  order n   [log10 probability: float] per n-gram, at its offset, which is a multiple of 64
+ *
+ * The n-gram of alphabet indices a, b, c, d is entry ((a * size + b) * size + c) * size + d of order 4,
+ * and likewise for the lower orders. N-grams that never occur in the corpus get the probability of
+ * 1/100 of a single occurrence. symbols is the length of the corpus in alphabet symbols.
+ */
+namespace ngram_tables {
+
+constexpr const size_t max_order = 4;
+constexpr const char magic[8] = {'C', 'R', 'N', 'G', 'R', 'A', 'M', '1'};
+constexpr const size_t table_alignment = 64;
+
+struct header {
+    char magic[8];
+    uint32_t alphabet_size;
+    uint32_t orders;
+    uint64_t symbols;
+    uint64_t offsets[max_order];
+};
+
+//n-grams of one order: alphabet_size^order
+inline size_t entries(size_t alphabet_size, size_t order) {
+    size_t result = 1;
+    for (size_t i = 0; i < order; ++i) {
+        result *= alphabet_size;
+    }
+    return result;
+}
+
+/**
+ * Alphabet index of a corpus code point, -1 if it is not in the alphabet. Lower case Cyrillic and Latin
+ * letters count as their upper case forms; the training of solver::quadgram_model uses the same rule.
+ */
+template<typename Alphabet>
+int symbol_index(uint32_t code_point) {
+    if ((code_point >= 'a' && code_point <= 'z') || (code_point >= 0x430 && code_point <= 0x44F)) {
+        code_point -= 0x20;
+    }
+    return Alphabet::index_of(typename Alphabet::char_type(code_point));
+}
+
+//header of the file for an alphabet of alphabet_size symbols, with the offsets of its tables
+inline header layout(size_t alphabet_size, uint64_t symbols) {
+    header result{};
+    std::memcpy(result.magic, magic, sizeof(magic));
+    result.alphabet_size = uint32_t(alphabet_size);
+    result.orders = max_order;
+    result.symbols = symbols;
+    uint64_t offset = sizeof(header) + alphabet_size * sizeof(uint32_t);
+    for (size_t order = 1; order <= max_order; ++order) {
+        offset = (offset + table_alignment - 1) / table_alignment * table_alignment;
+        result.offsets[order - 1] = offset;
+        offset += entries(alphabet_size, order) * sizeof(float);
+    }
+    return result;
+}
+
+//writes the tables of an alphabet, tables[n - 1] holds the scores of order n
+inline void write(const std::string& path, const std::vector<uint32_t>& alphabet, uint64_t symbols,
+                  const std::array<std::vector<float>, max_order>& tables) {
+    const header info = layout(alphabet.size(), symbols);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    out.write(reinterpret_cast<const char*>(&info), sizeof(info));
+    out.write(reinterpret_cast<const char*>(alphabet.data()), std::streamsize(alphabet.size() * sizeof(uint32_t)));
+    for (size_t order = 1; order <= max_order; ++order) {
+        const std::vector<float>& table = tables[order - 1];
+        if (table.size() != entries(alphabet.size(), order)) {
+            throw std::logic_error("Table size does not match the alphabet");
+        }
+        static const char padding[table_alignment] = {};
+        out.write(padding, std::streamsize(info.offsets[order - 1] - uint64_t(out.tellp())));
+        out.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size() * sizeof(float)));
+    }
+    if (!out.flush()) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+//a table file mapped into memory, validated against its own layout
+class mapped_table {
+    mapped_file file;
+
+    [[nodiscard]] const header& info() const {
+        return *reinterpret_cast<const header*>(file.data());
+    }
+
+public:
+    explicit mapped_table(const std::string& path) : file(path) {
+        if (file.size() < sizeof(header) || std::memcmp(info().magic, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error(path + " is not an n-gram table");
+        }
+        //alphabet indices fit in a signed byte, see alphabet.h
+        if (info().alphabet_size == 0 || info().alphabet_size >= 128) {
+            throw std::runtime_error(path + " has an invalid alphabet size");
+        }
+        const header expected = layout(info().alphabet_size, info().symbols);
+        const size_t end = expected.offsets[max_order - 1] + entries(info().alphabet_size, max_order) * sizeof(float);
+        if (info().orders != max_order || file.size() < end ||
+            std::memcmp(info().offsets, expected.offsets, sizeof(expected.offsets)) != 0) {
+            throw std::runtime_error(path + " is truncated or has an unknown layout");
+        }
+    }
+
+    [[nodiscard]] size_t alphabet_size() const {
+        return info().alphabet_size;
+    }
+
+    [[nodiscard]] uint64_t symbols() const {
+        return info().symbols;
+    }
+
+    [[nodiscard]] const uint32_t* alphabet() const {
+        return reinterpret_cast<const uint32_t*>(file.data() + sizeof(header));
+    }
+
+    //the alphabet_size^n scores of order n
+    [[nodiscard]] const float* order(size_t n) const {
+        return reinterpret_cast<const float*>(file.data() + info().offsets[n - 1]);
+    }
+
+    //whether the table was built for exactly this alphabet, symbol for symbol
+    template<typename Alphabet>
+    [[nodiscard]] bool matches() const {
+        if (alphabet_size() != Alphabet::size) {
+            return false;
+        }
+        for (size_t i = 0; i < Alphabet::size; ++i) {
+            if (alphabet()[i] != uint32_t(Alphabet::symbol_at(i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
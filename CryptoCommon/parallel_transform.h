@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+constexpr const size_t MIN_PARALLEL_CHUNK = 1 << 16;
+
+//chunk boundaries for splitting size elements over at most `threads` workers, never below min_chunk elements
+inline std::vector<size_t> chunk_bounds(size_t size, size_t threads, size_t min_chunk = MIN_PARALLEL_CHUNK) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunks = std::max<size_t>(1, std::min(threads, (size + min_chunk - 1) / min_chunk));
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= chunks; ++i) {
+        bounds.push_back(size / chunks * i + std::min(i, size % chunks));
+    }
+    return bounds;
+}
+
+/**
+ * Runs job(chunk index, begin, end) for every chunk, the last one on the calling thread.
+ * Rethrows the exception of the first failing chunk after all of them finished.
+ */
+template<typename Job>
+void for_each_chunk(const std::vector<size_t>& bounds, Job job) {
+    size_t chunks = bounds.size() - 1;
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+
+    auto run = [&](size_t chunk) {
+        try {
+            job(chunk, bounds[chunk], bounds[chunk + 1]);
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    for (size_t chunk = 0; chunk + 1 < chunks; ++chunk) {
+        workers.emplace_back(run, chunk);
+    }
+    run(chunks - 1);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * Parallel std::transform for position dependent functors.
+ * make_functor(chunk index, begin offset) has to return a functor in the state the sequential one
+ * would be in after begin symbols, so the chunks can be ciphered independently and the output
+ * is identical to the sequential path. Output is written in place, no reassembly is needed.
+ */
+template<typename String, typename FunctorFactory>
+String parallel_transform(const String& input, FunctorFactory make_functor, size_t threads = 0) {
+    String result(input.size(), typename String::value_type());
+    for_each_chunk(chunk_bounds(input.size(), threads), [&](size_t chunk, size_t begin, size_t end) {
+        std::transform(input.begin() + begin, input.begin() + end, result.begin() + begin, make_functor(chunk, begin));
+    });
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//hardware counters for instrumentation.h and CryptoScaling, Linux only
+namespace instrumentation {
+
+//cycles, instructions and cache misses of the calling thread, read as one group
+class perf_counters {
+public:
+    static constexpr size_t count = 3;
+    using values = std::array<uint64_t, count>;
+
+private:
+    std::array<int, count> fds{-1, -1, -1};
+
+    static int open_counter(uint64_t config, int group_fd) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return int(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+    }
+
+    perf_counters() {
+        const uint64_t configs[count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES};
+        for (size_t i = 0; i < count; ++i) {
+            fds[i] = open_counter(configs[i], i == 0 ? -1 : fds[0]);
+            if (fds[i] < 0) {
+                close_all();
+                return;
+            }
+        }
+    }
+
+    void close_all() {
+        for (auto& fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+    }
+
+public:
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    ~perf_counters() {
+        close_all();
+    }
+
+    static perf_counters& for_thread() {
+        thread_local perf_counters counters;
+        return counters;
+    }
+
+    [[nodiscard]] bool available() const {
+        return fds[0] >= 0;
+    }
+
+    bool read(values& result) const {
+        struct {
+            uint64_t nr;
+            uint64_t values[count];
+        } group{};
+        if (!available() || ::read(fds[0], &group, sizeof(group)) != ssize_t(sizeof(group))) {
+            return false;
+        }
+        std::copy(group.values, group.values + count, result.begin());
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "indexed_text.h"
+#include "instrumentation.h"
+#include "spsc_queue.h"
+
+/**
+ * Streams a file of lines through a cipher with reading, UTF-8 decoding, ciphering and encoding plus
+ * writing on four threads, so throughput is bounded by the slowest stage rather than by the sum of them.
+ *
+ *  reader -> decoder -> cipher -> writer
+ *     ^                             |
+ *     +-------- free batches -------+
+ *
+ * The stages hand batches of whole lines to each other through spsc_queues. A fixed set of batches
+ * circulates, the writer returns each one to the reader, so the buffers are recycled and only grow.
+ * Every line is ciphered as a message of its own; line breaks are copied through.
+ *
+ * run_bytes is the byte mode: reader -> cipher -> writer over raw blocks of the input, ciphered in place,
+ * for the byte_alphabet kernels. The input is one message there, every block knows its offset in it.
+ */
+namespace pipeline {
+
+//whole lines of the input in their three forms
+struct batch {
+    std::string input;
+    std::vector<indexed_text::index_type> indices;
+    //end of every line in indices
+    std::vector<size_t> line_ends;
+    std::string output;
+    //number of lines before this batch, for error messages
+    size_t first_line = 0;
+    //false if the last line ended the input without a line break
+    bool last_line_terminated = true;
+    //byte mode: position of the batch in the input
+    size_t offset = 0;
+    std::exception_ptr error;
+};
+
+constexpr const size_t batches = 8;
+constexpr const size_t default_block_size = 1 << 16;
+constexpr const size_t default_byte_block_size = 1 << 20;
+
+using batch_queue = spsc_queue<batch*, batches>;
+
+inline void write_all(int fd, const char* data, size_t size) {
+    while (size != 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Cannot write output");
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+/**
+ * Fills batches with whole lines of roughly block_size bytes. A line cut by the end of a read is carried
+ * over to the next batch, a line longer than block_size gets a batch of its own.
+ * Ends the stream with nullptr, early once the writer has failed.
+ */
+inline void read_stage(int fd, size_t block_size, batch_queue& free, batch_queue& out,
+                       const std::atomic<bool>& failed) {
+    std::string carry;
+    size_t lines = 0;
+    bool eof = false;
+    while (!eof && !failed.load(std::memory_order_relaxed)) {
+        batch* current = free.pop();
+        current->input.swap(carry);
+        carry.clear();
+        current->error = nullptr;
+        current->first_line = lines;
+        try {
+            INSTRUMENT_STAGE("pipeline.read", block_size);
+            size_t line_end = current->input.rfind('\n');
+            while (line_end == std::string::npos || current->input.size() < block_size) {
+                size_t size = current->input.size();
+                current->input.resize(size + block_size);
+                ssize_t n = ::read(fd, &current->input[size], block_size);
+                if (n < 0 && errno == EINTR) {
+                    current->input.resize(size);
+                    continue;
+                }
+                if (n < 0) {
+                    throw std::runtime_error("Cannot read input");
+                }
+                current->input.resize(size + n);
+                if (n == 0) {
+                    eof = true;
+                    break;
+                }
+                size_t found = current->input.rfind('\n');
+                line_end = found == std::string::npos ? line_end : found;
+            }
+            if (!eof || (line_end != std::string::npos && line_end + 1 == current->input.size())) {
+                carry.assign(current->input, line_end + 1, std::string::npos);
+                current->input.resize(line_end + 1);
+                current->last_line_terminated = true;
+            } else {
+                current->last_line_terminated = current->input.empty();
+            }
+        } catch (...) {
+            current->error = std::current_exception();
+            eof = true;
+        }
+        for (char ch : current->input) {
+            lines += ch == '\n';
+        }
+        if (current->input.empty() && !current->error) {
+            free.push(current);
+        } else {
+            out.push(current);
+        }
+    }
+    out.push(nullptr);
+}
+
+//splits the batch into lines and decodes every line into alphabet indices
+template<typename Alphabet>
+void decode_stage(batch_queue& in, batch_queue& out) {
+    while (batch* current = in.pop()) {
+        if (!current->error) {
+            INSTRUMENT_STAGE("pipeline.decode", current->input.size());
+            const std::string& input = current->input;
+            if (current->indices.size() < input.size()) {
+                current->indices.resize(input.size());
+            }
+            current->line_ends.clear();
+            size_t decoded = 0;
+            size_t line_begin = 0;
+            while (line_begin < input.size()) {
+                size_t line_end = input.find('\n', line_begin);
+                if (line_end == std::string::npos) {
+                    line_end = input.size();
+                }
+                try {
+                    decoded += indexed_text::decode<Alphabet>(input.data() + line_begin, input.data() + line_end,
+                                                              current->indices.data() + decoded);
+                } catch (const std::exception& e) {
+                    current->error = std::make_exception_ptr(std::runtime_error(
+                            "Line " + std::to_string(current->first_line + current->line_ends.size() + 1) + ": " +
+                            e.what()));
+                    break;
+                }
+                current->line_ends.push_back(decoded);
+                line_begin = line_end + 1;
+            }
+        }
+        out.push(current);
+    }
+    out.push(nullptr);
+}
+
+//ciphers every line in place, cipher(begin, end, out) as the index kernels of the exercises
+template<typename Cipher>
+void cipher_stage(batch_queue& in, batch_queue& out, Cipher& cipher) {
+    while (batch* current = in.pop()) {
+        if (!current->error) {
+            INSTRUMENT_STAGE("pipeline.cipher", current->line_ends.empty() ? 0 : current->line_ends.back());
+            try {
+                size_t line_begin = 0;
+                for (size_t line_end : current->line_ends) {
+                    indexed_text::index_type* line = current->indices.data();
+                    cipher(line + line_begin, line + line_end, line + line_begin);
+                    line_begin = line_end;
+                }
+            } catch (...) {
+                current->error = std::current_exception();
+            }
+        }
+        out.push(current);
+    }
+    out.push(nullptr);
+}
+
+//encodes the lines back to UTF-8 and writes them; returns the first error of any stage
+template<typename Alphabet>
+std::exception_ptr write_stage(int fd, batch_queue& in, batch_queue& free, std::atomic<bool>& failed) {
+    std::exception_ptr error;
+    while (batch* current = in.pop()) {
+        if (!error && current->error) {
+            error = current->error;
+            failed.store(true, std::memory_order_relaxed);
+        }
+        if (!error) {
+            try {
+                INSTRUMENT_STAGE("pipeline.write", current->input.size());
+                size_t symbols = current->line_ends.empty() ? 0 : current->line_ends.back();
+                current->output.resize(utf8::max_encoded(symbols) + current->line_ends.size());
+                char* out = &current->output[0];
+                size_t line_begin = 0;
+                for (size_t line = 0; line < current->line_ends.size(); ++line) {
+                    size_t line_end = current->line_ends[line];
+                    out += indexed_text::encode<Alphabet>(current->indices.data() + line_begin,
+                                                          current->indices.data() + line_end, out);
+                    if (line + 1 < current->line_ends.size() || current->last_line_terminated) {
+                        *out++ = '\n';
+                    }
+                    line_begin = line_end;
+                }
+                write_all(fd, current->output.data(), out - current->output.data());
+            } catch (...) {
+                error = std::current_exception();
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        free.push(current);
+    }
+    return error;
+}
+
+/**
+ * Runs the pipeline from in_fd to out_fd until the end of the input, the writer takes the calling thread.
+ * Rethrows the first error of any stage after the stages stopped; the output ends with the batch before it.
+ */
+template<typename Alphabet, typename Cipher>
+void run(int in_fd, int out_fd, Cipher cipher, size_t block_size = default_block_size) {
+    std::array<batch, batches> storage;
+    batch_queue free;
+    batch_queue read;
+    batch_queue decoded;
+    batch_queue ciphered;
+    std::atomic<bool> failed{false};
+    for (auto& item : storage) {
+        free.push(&item);
+    }
+
+    std::thread reader(read_stage, in_fd, block_size, std::ref(free), std::ref(read), std::cref(failed));
+    std::thread decoder(decode_stage<Alphabet>, std::ref(read), std::ref(decoded));
+    std::thread cipherer([&]() { cipher_stage(decoded, ciphered, cipher); });
+    std::exception_ptr error = write_stage<Alphabet>(out_fd, ciphered, free, failed);
+    reader.join();
+    decoder.join();
+    cipherer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+//byte mode: fills batches with block_size bytes of the input, or the rest of it
+inline void read_bytes_stage(int fd, size_t block_size, batch_queue& free, batch_queue& out,
+                             const std::atomic<bool>& failed) {
+    size_t offset = 0;
+    bool eof = false;
+    while (!eof && !failed.load(std::memory_order_relaxed)) {
+        batch* current = free.pop();
+        current->error = nullptr;
+        current->offset = offset;
+        current->input.resize(block_size);
+        size_t size = 0;
+        try {
+            INSTRUMENT_STAGE("pipeline.read", block_size);
+            while (size < block_size) {
+                ssize_t n = ::read(fd, &current->input[size], block_size - size);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n < 0) {
+                    throw std::runtime_error("Cannot read input");
+                }
+                if (n == 0) {
+                    eof = true;
+                    break;
+                }
+                size += n;
+            }
+        } catch (...) {
+            current->error = std::current_exception();
+            eof = true;
+        }
+        current->input.resize(size);
+        offset += size;
+        if (size == 0 && !current->error) {
+            free.push(current);
+        } else {
+            out.push(current);
+        }
+    }
+    out.push(nullptr);
+}
+
+//byte mode: ciphers every block in place, cipher(begin, end, out, offset) as the byte_alphabet kernels
+template<typename Cipher>
+void cipher_bytes_stage(batch_queue& in, batch_queue& out, Cipher& cipher) {
+    while (batch* current = in.pop()) {
+        if (!current->error) {
+            INSTRUMENT_STAGE("pipeline.cipher", current->input.size());
+            try {
+                auto* block = reinterpret_cast<uint8_t*>(&current->input[0]);
+                cipher(block, block + current->input.size(), block, current->offset);
+            } catch (...) {
+                current->error = std::current_exception();
+            }
+        }
+        out.push(current);
+    }
+    out.push(nullptr);
+}
+
+//byte mode: writes the blocks; returns the first error of any stage
+inline std::exception_ptr write_bytes_stage(int fd, batch_queue& in, batch_queue& free, std::atomic<bool>& failed) {
+    std::exception_ptr error;
+    while (batch* current = in.pop()) {
+        if (!error && current->error) {
+            error = current->error;
+            failed.store(true, std::memory_order_relaxed);
+        }
+        if (!error) {
+            try {
+                INSTRUMENT_STAGE("pipeline.write", current->input.size());
+                write_all(fd, current->input.data(), current->input.size());
+            } catch (...) {
+                error = std::current_exception();
+                failed.store(true, std::memory_order_relaxed);
+            }
+        }
+        free.push(current);
+    }
+    return error;
+}
+
+//byte mode of run, the input is raw bytes ciphered as a whole
+template<typename Cipher>
+void run_bytes(int in_fd, int out_fd, Cipher cipher, size_t block_size = default_byte_block_size) {
+    std::array<batch, batches> storage;
+    batch_queue free;
+    batch_queue read;
+    batch_queue ciphered;
+    std::atomic<bool> failed{false};
+    for (auto& item : storage) {
+        free.push(&item);
+    }
+
+    std::thread reader(read_bytes_stage, in_fd, block_size, std::ref(free), std::ref(read), std::cref(failed));
+    std::thread cipherer([&]() { cipher_bytes_stage(read, ciphered, cipher); });
+    std::exception_ptr error = write_bytes_stage(out_fd, ciphered, free, failed);
+    reader.join();
+    cipherer.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
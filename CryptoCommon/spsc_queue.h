@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * A ring of Capacity slots (a power of two) with the producer owning tail and the consumer owning head,
+ * each on its own cache line. push() and pop() spin, yielding the core, while the queue is full or empty;
+ * the pipeline stages using it are expected to be busy most of the time.
+ */
+template<typename T, size_t Capacity>
+class spsc_queue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    static constexpr size_t cache_line = 64;
+
+    std::array<T, Capacity> slots{};
+    alignas(cache_line) std::atomic<size_t> head{0};
+    alignas(cache_line) std::atomic<size_t> tail{0};
+
+public:
+    bool try_push(const T& value) {
+        size_t current = tail.load(std::memory_order_relaxed);
+        if (current - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        slots[current & (Capacity - 1)] = value;
+        tail.store(current + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        size_t current = head.load(std::memory_order_relaxed);
+        if (current == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[current & (Capacity - 1)];
+        head.store(current + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T& value) {
+        while (!try_push(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    T pop() {
+        T value;
+        while (!try_pop(value)) {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+};
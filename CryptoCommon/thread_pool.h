@@ -0,0 +1,78 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * Fixed size pool of worker threads over one bounded FIFO queue.
+ * submit() blocks while the queue is full, so a fast producer cannot run ahead of the workers
+ * by more than queue_capacity tasks. The destructor drains the queue and joins the workers.
+ */
+class thread_pool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    const size_t queue_capacity;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            not_full.notify_one();
+            task();
+        }
+    }
+
+public:
+    explicit thread_pool(size_t threads = std::thread::hardware_concurrency(), size_t queue_capacity = 1024)
+            : queue_capacity(queue_capacity) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(&thread_pool::work, this);
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        not_empty.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this] { return tasks.size() < queue_capacity; });
+            tasks.push(std::move(task));
+        }
+        not_empty.notify_one();
+    }
+
+    [[nodiscard]] size_t size() const {
+        return workers.size();
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * UTF-8 <-> UTF-32 wchar_t conversion into caller provided buffers, a non-allocating replacement for
+ * wstring_convert<codecvt_utf8<wchar_t>>. Rejects what codecvt_utf8 rejects: malformed and overlong
+ * sequences, surrogates and code points above U+10FFFF.
+ */
+namespace utf8 {
+
+//buffer sizes that always suffice
+constexpr size_t max_decoded(size_t bytes) {
+    return bytes;
+}
+
+constexpr size_t max_encoded(size_t symbols) {
+    return symbols * 4;
+}
+
+//decodes the symbol starting at it and advances it past the symbol
+inline uint32_t decode_symbol(const char*& it, const char* end) {
+    auto continuation = [&]() {
+        if (it == end || (uint8_t(*it) & 0xC0) != 0x80) {
+            throw std::range_error("Invalid UTF-8 input");
+        }
+        return uint32_t(uint8_t(*it++) & 0x3F);
+    };
+
+    uint8_t lead = uint8_t(*it++);
+    if (lead < 0x80) {
+        return lead;
+    }
+    uint32_t code;
+    uint32_t min;
+    if ((lead & 0xE0) == 0xC0) {
+        code = lead & 0x1F;
+        min = 0x80;
+        code = (code << 6) | continuation();
+    } else if ((lead & 0xF0) == 0xE0) {
+        code = lead & 0x0F;
+        min = 0x800;
+        code = (code << 6) | continuation();
+        code = (code << 6) | continuation();
+    } else if ((lead & 0xF8) == 0xF0) {
+        code = lead & 0x07;
+        min = 0x10000;
+        code = (code << 6) | continuation();
+        code = (code << 6) | continuation();
+        code = (code << 6) | continuation();
+    } else {
+        throw std::range_error("Invalid UTF-8 input");
+    }
+    if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+        throw std::range_error("Invalid UTF-8 input");
+    }
+    return code;
+}
+
+//encodes one code point into out, which has room for 4 bytes; returns the end of the written bytes
+inline char* encode_symbol(uint32_t code, char* out) {
+    if (code < 0x80) {
+        *out++ = char(code);
+    } else if (code < 0x800) {
+        *out++ = char(0xC0 | (code >> 6));
+        *out++ = char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        if (code >= 0xD800 && code <= 0xDFFF) {
+            throw std::range_error("Invalid code point");
+        }
+        *out++ = char(0xE0 | (code >> 12));
+        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+        *out++ = char(0x80 | (code & 0x3F));
+    } else if (code <= 0x10FFFF) {
+        *out++ = char(0xF0 | (code >> 18));
+        *out++ = char(0x80 | ((code >> 12) & 0x3F));
+        *out++ = char(0x80 | ((code >> 6) & 0x3F));
+        *out++ = char(0x80 | (code & 0x3F));
+    } else {
+        throw std::range_error("Invalid code point");
+    }
+    return out;
+}
+
+//decodes [begin, end) into out, which needs room for max_decoded(end - begin) symbols; returns the symbols written
+inline size_t decode(const char* begin, const char* end, wchar_t* out) {
+    wchar_t* const first = out;
+    const char* it = begin;
+    while (it != end) {
+        *out++ = wchar_t(decode_symbol(it, end));
+    }
+    return out - first;
+}
+
+//encodes [begin, end) into out, which needs room for max_encoded(end - begin) bytes; returns the bytes written
+inline size_t encode(const wchar_t* begin, const wchar_t* end, char* out) {
+    char* const first = out;
+    for (const wchar_t* it = begin; it != end; ++it) {
+        out = encode_symbol(uint32_t(*it), out);
+    }
+    return out - first;
+}
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of worker threads with a task deque each, for tasks of very different sizes that spawn sub-tasks.
+ * A worker runs its own tasks newest first, so the sub-tasks of the task it just ran stay on its core,
+ * and when it has none left steals the oldest task of another worker, the one most likely to be large.
+ * Tasks submitted from outside the pool are spread round robin over the deques.
+ *
+ * wait() blocks until every task submitted so far, including the ones submitted by tasks, has finished,
+ * and rethrows the first exception a task let escape. The destructor waits as well and joins the workers.
+ */
+class work_stealing_pool {
+    struct alignas(64) task_queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> unfinished{0};
+    std::atomic<size_t> next_queue{0};
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_finished;
+    std::exception_ptr error;
+    bool stopping = false;
+
+    //the pool and deque of the calling worker thread, nullptr outside of workers
+    inline static thread_local work_stealing_pool* current_pool = nullptr;
+    inline static thread_local size_t current_queue = 0;
+
+    bool pop(size_t index, std::function<void()>& task) {
+        task_queue& own = *queues[index];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            task_queue& victim = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t index) {
+        current_pool = this;
+        current_queue = index;
+        while (true) {
+            std::function<void()> task;
+            if (queued.load(std::memory_order_acquire) != 0 && pop(index, task)) {
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    all_finished.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(state_mutex);
+            work_available.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) != 0; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit work_stealing_pool(size_t threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            queues.push_back(std::make_unique<task_queue>());
+        }
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(&work_stealing_pool::work, this, i);
+        }
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool() {
+        {
+            std::unique_lock<std::mutex> lock(state_mutex);
+            all_finished.wait(lock, [this] { return unfinished.load(std::memory_order_acquire) == 0; });
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    //from a worker of this pool onto its own deque, from anywhere else round robin
+    void submit(std::function<void()> task) {
+        size_t index = current_pool == this ? current_queue : next_queue.fetch_add(1) % queues.size();
+        //counted before they are pushed, so queued never falls below the tasks in the deques
+        unfinished.fetch_add(1, std::memory_order_relaxed);
+        queued.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        //under the lock, so a worker between its check and its wait cannot miss the notification
+        std::lock_guard<std::mutex> lock(state_mutex);
+        work_available.notify_one();
+    }
+
+    //must not be called from a task
+    void wait() {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        all_finished.wait(lock, [this] { return unfinished.load(std::memory_order_acquire) == 0; });
+        if (error) {
+            std::exception_ptr first = error;
+            error = nullptr;
+            std::rethrow_exception(first);
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return workers.size();
+    }
+};
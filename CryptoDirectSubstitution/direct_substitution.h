@@ -0,0 +1,201 @@
+#pragma once
+
+#include <string>
+#include <iterator>
+#include <stdexcept>
+#include <array>
+#include <cstring>
+#include "alphabet.h"
+#include "indexed_text.h"
+#include "instrumentation.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace direct_substitution {
+
+using symbols_type = alphabets::direct_substitution;
+constexpr const auto& allowed_symbols = alphabets::direct_substitution_traits::symbols;
+//indexed by the position of the symbol in allowed_symbols
+constexpr const int mapped_values[] = {10,20,30,40,15,25,11,21,31,41,35,45,12,22,32,42,13,23,33,43,14,24,34,16,26,36,17,27,37,
+                                       18,28,38,19,29,39,1,2,3,4,5,6,7,8,9};
+constexpr const int max_mapped_value = 45;
+constexpr const size_t max_input_length = 300;
+
+static_assert(std::size(mapped_values) == symbols_type::size, "every symbol needs a code");
+
+enum Operation { Encrypt = 1, Decrypt };
+
+class encryptor {
+public:
+    int operator()(const wchar_t& symbol) const {
+        return mapped_values[symbols_type::checked_index_of(symbol)];
+    }
+
+    //validating form for kernels that know where the symbol is, throws illegal_symbol with its offset
+    int operator()(const wchar_t& symbol, size_t offset) const {
+        return mapped_values[symbols_type::checked_index_of(symbol, offset)];
+    }
+};
+
+//longest text of one code: two digits and the separator
+constexpr const size_t max_code_chars = 3;
+
+//writes the codes of [begin, end) as text, "10 20 ", into out, which has room for max_code_chars per symbol;
+// returns the number of chars written. Symbols are validated in the same pass, see encryptor
+inline size_t write_codes(const wchar_t* begin, const wchar_t* end, char* out) {
+    INSTRUMENT_STAGE("direct_substitution.encrypt", (end - begin) * sizeof(wchar_t));
+    encryptor encrypt;
+    char* const first = out;
+    for (const wchar_t* it = begin; it != end; ++it) {
+        int code = encrypt(*it, it - begin);
+        if (code >= 10) {
+            *out++ = char('0' + code / 10);
+        }
+        *out++ = char('0' + code % 10);
+        *out++ = ' ';
+    }
+    return out - first;
+}
+
+//the text of every code with its separator, "10 ", indexed by alphabet index
+constexpr const auto code_texts = [] {
+    std::array<std::array<char, max_code_chars + 1>, symbols_type::size> texts{};
+    for (size_t i = 0; i < symbols_type::size; ++i) {
+        int code = mapped_values[i];
+        size_t at = 0;
+        if (code >= 10) {
+            texts[i][at++] = char('0' + code / 10);
+        }
+        texts[i][at++] = char('0' + code % 10);
+        texts[i][at++] = ' ';
+        texts[i][max_code_chars] = char(at);
+    }
+    return texts;
+}();
+
+//index form of write_codes, for text decoded with indexed_text; copies each code's text from code_texts
+inline size_t write_codes(const indexed_text::index_type* begin, const indexed_text::index_type* end, char* out) {
+    INSTRUMENT_STAGE("direct_substitution.encrypt_indices", end - begin);
+    char* const first = out;
+    for (const indexed_text::index_type* it = begin; it != end; ++it) {
+        const auto& text = code_texts[*it];
+        std::memcpy(out, text.data(), max_code_chars);
+        out += text[max_code_chars];
+    }
+    return out - first;
+}
+
+//dense inverse of mapped_values, indexed directly by the code; 0 marks codes without a symbol
+class code_table {
+    std::array<wchar_t, max_mapped_value + 1> symbols;
+
+public:
+    constexpr code_table() : symbols() {
+        for (size_t i = 0; i < std::size(mapped_values); i++) {
+            symbols[mapped_values[i]] = symbols_type::symbol_at(i);
+        }
+    }
+
+    wchar_t at(int code) const {
+        if (code < 0 || code > max_mapped_value || symbols[code] == 0) {
+            throw std::runtime_error("Illegal symbol detected");
+        }
+        return symbols[code];
+    }
+};
+
+constexpr const code_table number_to_symbol;
+
+inline bool is_separator(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+inline bool is_digit(char ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+/**
+ * Reads whitespace separated one or two digit codes and writes the decoded symbols to an output iterator.
+ * Does not allocate; the caller decides where the symbols go.
+ * Runs of five "dd " tokens (15 bytes) are recognized with a single SIMD compare when SSE2 is available.
+ */
+class decryptor {
+    const code_table& table;
+    const size_t max_length;
+
+    template<typename Out>
+    bool parse_block(const char* in, Out& out) const {
+#ifdef __SSE2__
+        const int digit_positions = 0x36db; //bits 0,1 3,4 6,7 9,10 12,13
+        const int space_positions = 0x4924; //bits 2 5 8 11 14
+
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('0' - 1)),
+                                       _mm_cmplt_epi8(chunk, _mm_set1_epi8('9' + 1)));
+        __m128i spaces = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+
+        if ((_mm_movemask_epi8(digits) & 0x7fff) != digit_positions ||
+                (_mm_movemask_epi8(spaces) & 0x7fff) != space_positions) {
+            return false;
+        }
+        for (int i = 0; i < 15; i += 3) {
+            *out++ = table.at((in[i] - '0') * 10 + (in[i + 1] - '0'));
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+public:
+    explicit decryptor(const code_table& table, size_t max_length = max_input_length)
+        : table(table), max_length(max_length) {}
+
+    template<typename Out>
+    size_t operator()(const char* begin, const char* end, Out out) const {
+        INSTRUMENT_STAGE("direct_substitution.decrypt", end - begin);
+        size_t count = 0;
+        const char* it = begin;
+
+        while (true) {
+            while (it != end && is_separator(*it)) {
+                ++it;
+            }
+            if (it == end) {
+                break;
+            }
+            if (end - it >= 16 && count + 5 <= max_length && parse_block(it, out)) {
+                it += 15;
+                count += 5;
+                continue;
+            }
+
+            if (!is_digit(*it)) {
+                throw std::runtime_error("Illegal symbol detected");
+            }
+            int code = *it++ - '0';
+            if (it != end && is_digit(*it)) {
+                code = code * 10 + (*it++ - '0');
+            }
+            if (it != end && !is_separator(*it)) {
+                throw std::runtime_error("Illegal symbol detected");
+            }
+            if (++count > max_length) {
+                throw std::runtime_error("Illegal plain text length");
+            }
+            *out++ = table.at(code);
+        }
+        return count;
+    }
+};
+
+//symbols are checked by the encryptor in the same pass that encodes them
+inline void validate_input(const std::wstring& input) {
+    INSTRUMENT_STAGE("direct_substitution.validate", input.size() * sizeof(wchar_t));
+    if (input.size() > max_input_length) {
+        throw std::runtime_error("Illegal plain text length");
+    }
+}
+
+}
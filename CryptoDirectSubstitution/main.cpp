@@ -1,18 +1,14 @@
 #include <iostream>
-#include <unordered_map>
-#include <vector>
 #include <algorithm>
 #include <codecvt>
 #include <locale>
-#include <regex>
+#include <iterator>
+#include <cstring>
+#include "wire_format.h"
+#include "direct_substitution.h"
 
 using namespace std;
-
-const wchar_t allowed_symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ0123456789 .-#";
-const int mapped_values[] = {10,20,30,40,15,25,11,21,31,41,35,45,12,22,32,42,13,23,33,43,14,24,34,16,26,36,17,27,37,
-                             18,28,38,19,29,39,1,2,3,4,5,6,7,8,9};
-
-enum Operation { Encrypt = 1, Decrypt };
+using namespace direct_substitution;
 
 inline istream& operator>>(istream& in, Operation& operation) {
     int val;
@@ -21,111 +17,110 @@ inline istream& operator>>(istream& in, Operation& operation) {
     return in;
 }
 
-class encryptor {
-    unordered_map<wchar_t, int> mappings;
-
-public:
-    explicit encryptor(const unordered_map<wchar_t, int>& mappings) : mappings(mappings) {}
-
-    int operator()(const wchar_t& symbol) {
-        return mappings.at(symbol);
-    }
-};
-
-class decryptor {
-    unordered_map<int, wchar_t> mappings;
-
-public:
-    explicit decryptor(const unordered_map<int, wchar_t>& mappings) : mappings(mappings) {}
-
-    wchar_t operator()(const int& symbol) {
-        return mappings.at(symbol);
-    }
-};
-
-template<typename Map, typename Input>
-void validate_input(const Map& map, const Input& input) {
-    if (input.size() > 300) {
-        throw runtime_error("Illegal plain text length");
-    }
-    for (auto val : input) {
-        if (map.find(val) == map.end()) {
-            throw runtime_error("Illegal symbol detected");
-        }
-    }
-}
-
 //necessary because Windows doesn't natively support wide character streams
 inline ostream& operator<<(ostream& out, const wstring& utf16) {
-    wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
-    string utf8 = converter.to_bytes(utf16);
+    string utf8;
+    {
+        INSTRUMENT_STAGE("utf8_encode", utf16.size() * sizeof(wchar_t));
+        wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
+        utf8 = converter.to_bytes(utf16);
+    }
+    INSTRUMENT_STAGE("output", utf8.size());
     out << utf8;
     return out;
 }
 
-//necessary because Windows doesn't natively support wide character streams
-inline istream& operator>>(istream& in, wstring& utf16) {
+//reads one message per line and writes it as packed frames, see wire_format.h
+void packed_encrypt(istream& in, ostream& out) {
     wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
-    string utf8;
-    getline(cin, utf8);
-    if (!utf8.empty()) {
-        utf16 = converter.from_bytes(utf8);
+    encryptor encrypt;
+    packed_writer writer(out);
+
+    string line;
+    while (getline(in, line)) {
+        wstring input = converter.from_bytes(line);
+        for (size_t offset = 0; offset < input.size(); ++offset) {
+            writer.put(encrypt(input[offset], offset));
+        }
+        writer.end_message();
     }
-    return in;
 }
 
-int main() {
-    unordered_map<wchar_t, int> symbol_to_number;
-    unordered_map<int, wchar_t> number_to_symbol;
-    int n = wcslen(allowed_symbols);
-    int n1 = size(mapped_values);
+//decodes packed frames frame by frame, writing one message per line
+void packed_decrypt(istream& in, ostream& out) {
+    packed_reader reader(in);
+    uint8_t codes[PACKED_FRAME_CODES];
+    size_t count;
+    wstring result;
+    result.reserve(PACKED_FRAME_CODES);
+
+    while (reader.read_frame(codes, count)) {
+        if (count == 0) {
+            out << '\n';
+            continue;
+        }
+        result.clear();
+        transform(codes, codes + count, back_inserter(result), [&](uint8_t code) { return number_to_symbol.at(code); });
+        out << result;
+    }
+}
 
-    for (int i = 0; n == n1 && i < n; i++) {
-        symbol_to_number.emplace(allowed_symbols[i], mapped_values[i]);
-        number_to_symbol.emplace(mapped_values[i], allowed_symbols[i]);
+int main(int argc, char* argv[]) {
+
+    //non-interactive streaming modes for piping whole files through the packed binary format
+    if (argc > 1 && (strcmp(argv[1], "--pack") == 0 || strcmp(argv[1], "--unpack") == 0)) {
+        ios::sync_with_stdio(false);
+        try {
+            if (strcmp(argv[1], "--pack") == 0) {
+                packed_encrypt(cin, cout);
+            } else {
+                packed_decrypt(cin, cout);
+            }
+        } catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        return 0;
     }
 
+    decryptor decrypt(number_to_symbol);
+    wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
+
+    //read as raw UTF-8 so decryption can parse the codes without converting the line back and forth
     cout << "Enter input: ";
-    wstring input;
-    cin >> input;
+    string line;
+    getline(cin, line);
 
-    while (input != L"exit") {
+    while (line != "exit") {
         cout << "Enter operation (1: Encrypt, 2: Decrypt): ";
         Operation operation;
         cin >> operation;
 
         if (operation == Decrypt) {
-            //needed because wstring_token_iterator isn't supported by some systems
-            wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
-            string utf8 = converter.to_bytes(input);
-
-            vector<int> parsedInput;
-            regex space(" ");
-            transform(sregex_token_iterator(utf8.begin(), utf8.end(), space, -1),
-                      sregex_token_iterator(),
-                      back_inserter(parsedInput),
-                      [](auto& str){ return stoi(str); });
-
-            validate_input(number_to_symbol, parsedInput);
-
             wstring result;
-            transform(parsedInput.begin(), parsedInput.end(), back_inserter(result), decryptor(number_to_symbol));
+            result.reserve(line.size() / 2 + 1);
+            decrypt(line.data(), line.data() + line.size(), back_inserter(result));
 
             cout << result << endl;
         } else {
-            validate_input(symbol_to_number, input);
+            wstring input;
+            {
+                INSTRUMENT_STAGE("utf8_decode", line.size());
+                input = converter.from_bytes(line);
+            }
+            validate_input(input);
 
-            vector<int> result;
-            transform(input.begin(), input.end(), back_inserter(result), encryptor(symbol_to_number));
+            string result(input.size() * max_code_chars, '\0');
+            result.resize(write_codes(input.data(), input.data() + input.size(), &result[0]));
 
-            copy(result.begin(), result.end(), ostream_iterator<char>(cout, " "));
-            cout << endl;
+            INSTRUMENT_STAGE("output", result.size());
+            cout << result << endl;
         }
 
-        input.clear();
+        line.clear();
         cout << "Enter input: ";
         getchar();
-        cin >> input;
+        getline(cin, line);
     }
 
     return 0;
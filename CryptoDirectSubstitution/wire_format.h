@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+/**
+ * Packed binary form of the substitution codes.
+ * Every code is below 64, so it takes 6 bits and four codes fit in three bytes:
+ *  bytes[0..2] = c0 | c1 << 6 | c2 << 12 | c3 << 18 (little-endian)
+ *
+ * A stream is a sequence of frames:
+ *  [code count: 2 bytes, little-endian][packed codes: ceil(count * 6 / 8) bytes]
+ * and a frame with a count of 0 ends the current message.
+ */
+constexpr const size_t PACKED_FRAME_CODES = 4096;
+constexpr const size_t PACKED_HEADER_SIZE = 2;
+constexpr const uint8_t PACKED_CODE_MASK = 0x3f;
+
+constexpr size_t packed_size(size_t codes) {
+    return (codes * 6 + 7) / 8;
+}
+
+inline void pack_group(const uint8_t* codes, size_t count, uint8_t* out) {
+    uint32_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+        word |= uint32_t(codes[i] & PACKED_CODE_MASK) << (6 * i);
+    }
+    for (size_t i = 0; i < packed_size(count); ++i) {
+        out[i] = uint8_t(word >> (8 * i));
+    }
+}
+
+inline void unpack_group(const uint8_t* in, size_t count, uint8_t* codes) {
+    uint32_t word = 0;
+    for (size_t i = 0; i < packed_size(count); ++i) {
+        word |= uint32_t(in[i]) << (8 * i);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        codes[i] = uint8_t(word >> (6 * i)) & PACKED_CODE_MASK;
+    }
+}
+
+//returns the number of bytes written, always packed_size(count)
+inline size_t pack_codes(const uint8_t* codes, size_t count, uint8_t* out) {
+    size_t done = 0;
+    uint8_t* begin = out;
+#ifdef __SSE2__
+    //16 codes -> 4 lanes of 24 bits -> 12 bytes
+    for (; count - done >= 16; done += 16, out += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + done));
+        __m128i low = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x3f)),
+                                   _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x3f00)), 2));
+        __m128i high = _mm_or_si128(_mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x3f0000)), 4),
+                                    _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0x3f000000)), 6));
+        __m128i packed = _mm_or_si128(low, high);
+
+        alignas(16) uint8_t lanes[16];
+#ifdef __SSSE3__
+        packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), packed);
+        memcpy(out, lanes, 12);
+#else
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), packed);
+        for (int lane = 0; lane < 4; ++lane) {
+            memcpy(out + lane * 3, lanes + lane * 4, 3);
+        }
+#endif
+    }
+#endif
+    for (; count - done >= 4; done += 4, out += 3) {
+        pack_group(codes + done, 4, out);
+    }
+    if (done != count) {
+        pack_group(codes + done, count - done, out);
+        out += packed_size(count - done);
+    }
+    return out - begin;
+}
+
+//returns the number of bytes consumed, always packed_size(count)
+inline size_t unpack_codes(const uint8_t* in, size_t count, uint8_t* codes) {
+    size_t done = 0;
+    const uint8_t* begin = in;
+#ifdef __SSE2__
+    //12 bytes -> 4 lanes of 24 bits -> 16 codes
+    for (; count - done >= 16; done += 16, in += 12) {
+        alignas(16) uint8_t lanes[16] = {};
+        for (int lane = 0; lane < 4; ++lane) {
+            memcpy(lanes + lane * 4, in + lane * 3, 3);
+        }
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+        __m128i low = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0x3f)),
+                                   _mm_and_si128(_mm_slli_epi32(v, 2), _mm_set1_epi32(0x3f00)));
+        __m128i high = _mm_or_si128(_mm_and_si128(_mm_slli_epi32(v, 4), _mm_set1_epi32(0x3f0000)),
+                                    _mm_and_si128(_mm_slli_epi32(v, 6), _mm_set1_epi32(0x3f000000)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + done), _mm_or_si128(low, high));
+    }
+#endif
+    for (; count - done >= 4; done += 4, in += 3) {
+        unpack_group(in, 4, codes + done);
+    }
+    if (done != count) {
+        unpack_group(in, count - done, codes + done);
+        in += packed_size(count - done);
+    }
+    return in - begin;
+}
+
+class packed_writer {
+    std::ostream& out;
+    uint8_t codes[PACKED_FRAME_CODES];
+    uint8_t frame[PACKED_HEADER_SIZE + packed_size(PACKED_FRAME_CODES)];
+    size_t count = 0;
+
+    void write_frame() {
+        frame[0] = uint8_t(count);
+        frame[1] = uint8_t(count >> 8);
+        size_t size = PACKED_HEADER_SIZE + pack_codes(codes, count, frame + PACKED_HEADER_SIZE);
+        out.write(reinterpret_cast<const char*>(frame), size);
+        count = 0;
+    }
+
+public:
+    explicit packed_writer(std::ostream& out) : out(out) {}
+
+    void put(uint8_t code) {
+        codes[count++] = code;
+        if (count == PACKED_FRAME_CODES) {
+            write_frame();
+        }
+    }
+
+    void end_message() {
+        if (count != 0) {
+            write_frame();
+        }
+        write_frame();
+    }
+};
+
+class packed_reader {
+    std::istream& in;
+    uint8_t frame[packed_size(PACKED_FRAME_CODES)];
+
+public:
+    explicit packed_reader(std::istream& in) : in(in) {}
+
+    /**
+     * Reads the next frame into codes (at least PACKED_FRAME_CODES long).
+     * A count of 0 marks the end of a message; returns false on a clean end of stream.
+     */
+    bool read_frame(uint8_t* codes, size_t& count) {
+        uint8_t header[PACKED_HEADER_SIZE];
+        if (!in.read(reinterpret_cast<char*>(header), PACKED_HEADER_SIZE)) {
+            if (in.gcount() != 0) {
+                throw std::runtime_error("Truncated frame header");
+            }
+            return false;
+        }
+        count = header[0] | (size_t(header[1]) << 8);
+        if (count > PACKED_FRAME_CODES) {
+            throw std::runtime_error("Illegal frame length");
+        }
+        if (!in.read(reinterpret_cast<char*>(frame), packed_size(count))) {
+            throw std::runtime_error("Truncated frame");
+        }
+        unpack_codes(frame, count, codes);
+        return true;
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+#include "alphabet.h"
+#include "autotune.h"
+#include "parallel_transform.h"
+#include "instrumentation.h"
+
+namespace matrix_substitution {
+
+using symbols_type = alphabets::cyrillic;
+constexpr const auto& symbols = alphabets::cyrillic_traits::symbols;
+
+inline int index_of(const wchar_t& symbol) {
+    return symbols_type::index_of(symbol);
+}
+
+constexpr size_t index_in_matrix(size_t row, size_t col) {
+    return row * symbols_type::size + col;
+}
+
+//the Vigenère tableau, row i is the alphabet rotated left by i
+constexpr const auto tableau = [] {
+    constexpr size_t alphabet_size = symbols_type::size;
+    std::array<wchar_t, alphabet_size * alphabet_size> matrix{};
+    for (size_t row = 0; row < alphabet_size; ++row) {
+        for (size_t col = 0; col < alphabet_size; ++col) {
+            matrix[index_in_matrix(row, col)] = symbols_type::symbol_at((row + col) % alphabet_size);
+        }
+    }
+    return matrix;
+}();
+
+class encryptor {
+    //not owned, the key has to outlive the functor
+    std::wstring_view key;
+    size_t key_index = 0;
+
+public:
+    //key_offset: number of alphabet symbols before the first one this encryptor sees
+    explicit encryptor(std::wstring_view key, size_t key_offset = 0)
+        : key(key), key_index(key.empty() ? 0 : key_offset % key.size()) {}
+
+    wchar_t operator()(const wchar_t& symbol) {
+        int input_symbol_index = index_of(symbol);
+        if (input_symbol_index == -1) {
+            return symbol;
+        }
+
+        if (key_index >= key.size()) {
+            key_index -= key.size();
+        }
+        int key_symbol_index = index_of(key[key_index++]);
+        if (key_symbol_index == -1) {
+            throw std::runtime_error("Illegal symbol in key detected");
+        }
+
+        return tableau[index_in_matrix(key_symbol_index, input_symbol_index)];
+    }
+};
+
+//encrypts [begin, end) into out, which has room for end - begin symbols; does not allocate
+inline void encrypt_into(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out) {
+    INSTRUMENT_STAGE("matrix_substitution.encrypt", (end - begin) * sizeof(wchar_t));
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    std::transform(begin, end, out, encryptor(key));
+}
+
+/**
+ * Chunked parallel version of encrypt_into.
+ * Symbols outside the alphabet are copied without consuming a key symbol, so the key position of
+ * a chunk is the number of alphabet symbols before it, not its offset. A first parallel pass counts
+ * them per chunk, a prefix sum gives every chunk its starting key position.
+ */
+inline void parallel_encrypt_into(const wchar_t* begin, const wchar_t* end, std::wstring_view key, wchar_t* out,
+                                  size_t threads = 0) {
+    INSTRUMENT_STAGE("matrix_substitution.parallel_encrypt", (end - begin) * sizeof(wchar_t));
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    std::vector<size_t> bounds = chunk_bounds(end - begin, threads);
+    std::vector<size_t> key_offsets(bounds.size(), 0);
+    for_each_chunk(bounds, [&](size_t chunk, size_t from, size_t to) {
+        key_offsets[chunk + 1] = std::count_if(begin + from, begin + to,
+                                               [](wchar_t symbol) { return index_of(symbol) != -1; });
+    });
+    for (size_t chunk = 1; chunk < key_offsets.size(); ++chunk) {
+        key_offsets[chunk] += key_offsets[chunk - 1];
+    }
+
+    for_each_chunk(bounds, [&](size_t chunk, size_t from, size_t to) {
+        std::transform(begin + from, begin + to, out + from, encryptor(key, key_offsets[chunk]));
+    });
+}
+
+inline std::wstring parallel_encrypt(const std::wstring& input, const std::wstring& key, size_t threads = 0) {
+    std::wstring result(input.size(), L'\0');
+    parallel_encrypt_into(input.data(), input.data() + input.size(), key, &result[0], threads);
+    return result;
+}
+
+/**
+ * The encryption with the kernel autotune measured fastest for the size of the input on this machine.
+ * Symbols outside the alphabet pass through, so there is no index kernel, only the sequential and the parallel one.
+ */
+inline std::wstring encrypt(const std::wstring& input, const std::wstring& key) {
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    auto run = [](autotune::strategy strategy, const wchar_t* begin, const wchar_t* end, std::wstring_view key,
+                  wchar_t* out) {
+        if (strategy == autotune::PARALLEL) {
+            parallel_encrypt_into(begin, end, key, out);
+        } else {
+            encrypt_into(begin, end, key, out);
+        }
+    };
+    autotune::strategy strategy = autotune::choose<symbols_type>(
+        "matrix_substitution", input.size(), {autotune::SCALAR, autotune::PARALLEL},
+        [&](autotune::strategy kind, auto begin, auto end, auto out) { run(kind, begin, end, L"КЛЮЧ", out); });
+    std::wstring result(input.size(), L'\0');
+    run(strategy, input.data(), input.data() + input.size(), key, &result[0]);
+    return result;
+}
+
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/stat.h>
+#include "alphabet.h"
+#include "ngram_table.h"
+#include "ngram_builder.h"
+
+using namespace std;
+
+template<typename Alphabet>
+void build(const vector<string>& corpora, const string& output, size_t threads) {
+    using builder = ngrams::builder<Alphabet>;
+    auto start = chrono::steady_clock::now();
+    auto counts = builder::count_files(corpora, threads);
+    auto scores = builder::score(counts);
+    uint64_t symbols = 0;
+    for (uint64_t value : counts[0]) {
+        symbols += value;
+    }
+    ngram_tables::write(output, builder::alphabet(), symbols, scores);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    uint64_t bytes = 0;
+    for (const auto& path : corpora) {
+        struct stat status{};
+        if (::stat(path.c_str(), &status) == 0) {
+            bytes += uint64_t(status.st_size);
+        }
+    }
+    cerr << symbols << " symbols from " << bytes << " bytes in " << seconds << " s ("
+         << double(bytes) / 1e6 / seconds << " MB/s)" << endl;
+}
+
+void print_usage() {
+    cerr << "Usage: CryptoNgrams --alphabet name --output table.bin [--threads count] corpus...\n"
+            "Counts unigrams to quadgrams of the corpora (UTF-8 text) and writes their log10 probabilities.\n"
+            "Alphabets: cyrillic (block transposition, matrix substitution), cyrillic_digits (column transposition),\n"
+            "           cyrillic_latin (Caesar, polyalphabetic), direct_substitution, latin" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string alphabet;
+    string output;
+    size_t threads = 0;
+    vector<string> corpora;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            corpora.push_back(arg);
+            continue;
+        }
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        string value = argv[++i];
+        if (arg == "--alphabet") {
+            alphabet = value;
+        } else if (arg == "--output") {
+            output = value;
+        } else if (arg == "--threads") {
+            threads = stoul(value);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (alphabet.empty() || output.empty() || corpora.empty()) {
+        print_usage();
+        return 2;
+    }
+
+    try {
+        if (alphabet == "cyrillic") {
+            build<alphabets::cyrillic>(corpora, output, threads);
+        } else if (alphabet == "cyrillic_digits") {
+            build<alphabets::cyrillic_digits>(corpora, output, threads);
+        } else if (alphabet == "cyrillic_latin") {
+            build<alphabets::cyrillic_latin>(corpora, output, threads);
+        } else if (alphabet == "direct_substitution") {
+            build<alphabets::direct_substitution>(corpora, output, threads);
+        } else if (alphabet == "latin") {
+            build<alphabets::latin>(corpora, output, threads);
+        } else {
+            print_usage();
+            return 2;
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "utf8.h"
+#include "mapped_file.h"
+#include "ngram_table.h"
+#include "parallel_transform.h"
+
+namespace ngrams {
+
+//corpus bytes a worker takes at a time
+constexpr const size_t piece_size = 16 << 20;
+//bound on the count tables of all workers together, fewer workers are used beyond it
+constexpr const size_t counts_budget = size_t(1) << 30;
+
+/**
+ * Counts the unigrams to quadgrams of an alphabet in corpus files and turns them into ngram_tables scores.
+ *
+ * The files are mapped and cut into pieces at UTF-8 symbol boundaries. Workers take the pieces one after
+ * another and count into tables of their own, which are added up at the end. Text is reduced to alphabet
+ * indices as solver::quadgram_model does: upper cased, and symbols outside the alphabet become one space
+ * per run if the alphabet has a space and are dropped otherwise. Every file is a text of its own.
+ * The counts equal those of one pass over every file: a piece starts in the state the symbol before it
+ * leaves and counts the n-grams starting in it, reading past its end to complete them.
+ */
+template<typename Alphabet>
+class builder {
+public:
+    static constexpr size_t size = Alphabet::size;
+    static constexpr size_t max_order = ngram_tables::max_order;
+    using counts = std::array<std::vector<uint64_t>, max_order>;
+
+private:
+    struct piece {
+        const mapped_file* file;
+        size_t begin;
+        size_t end;
+    };
+
+    static constexpr int space = Alphabet::index_of(' ');
+
+    //the code point at it, advancing it past the symbol; invalid UTF-8 advances one byte and is no symbol
+    static uint32_t next_symbol(const char*& it, const char* end) {
+        const char* start = it;
+        try {
+            return utf8::decode_symbol(it, end);
+        } catch (const std::range_error&) {
+            it = start + 1;
+            return 0xFFFD;
+        }
+    }
+
+    static bool is_continuation(char byte) {
+        return (uint8_t(byte) & 0xC0) == 0x80;
+    }
+
+    //index of the symbol as counted, space for the symbols it replaces, -1 for dropped ones
+    static int counted_index(uint32_t code_point) {
+        int index = ngram_tables::symbol_index<Alphabet>(code_point);
+        return index == -1 ? space : index;
+    }
+
+    /**
+     * Alphabet indices of the symbols starting in the piece, followed by up to max_order - 1 indices
+     * of the symbols after it. Returns the number of indices of the piece's own symbols.
+     */
+    static size_t decode(const piece& part, std::vector<uint8_t>& out) {
+        const char* text = part.file->data();
+        const char* text_end = text + part.file->size();
+        const char* it = text + part.begin;
+        const char* limit = text + part.end;
+
+        //a space after a space is not counted, neither is one at the start of the text
+        bool after_space = true;
+        if (part.begin != 0) {
+            const char* previous = it - 1;
+            while (previous != text && it - previous < 4 && is_continuation(*previous)) {
+                --previous;
+            }
+            after_space = counted_index(next_symbol(previous, text_end)) == space;
+        }
+
+        out.clear();
+        size_t own = 0;
+        while (it != text_end) {
+            bool inside = it < limit;
+            if (!inside && out.size() >= own + max_order - 1) {
+                break;
+            }
+            int index = counted_index(next_symbol(it, text_end));
+            if (index == -1 || (index == space && after_space)) {
+                continue;
+            }
+            after_space = index == space;
+            out.push_back(uint8_t(index));
+            if (inside) {
+                own = out.size();
+            }
+        }
+        return own;
+    }
+
+    //adds the n-grams starting at the first own indices
+    static void count(const std::vector<uint8_t>& indices, size_t own, counts& result) {
+        for (size_t i = 0; i < own; ++i) {
+            size_t code = 0;
+            for (size_t order = 1; order <= max_order && i + order <= indices.size(); ++order) {
+                code = code * size + indices[i + order - 1];
+                ++result[order - 1][code];
+            }
+        }
+    }
+
+    static counts empty_counts() {
+        counts result;
+        for (size_t order = 1; order <= max_order; ++order) {
+            result[order - 1].assign(ngram_tables::entries(size, order), 0);
+        }
+        return result;
+    }
+
+public:
+    /**
+     * Counts over all files with up to threads workers (0 = all cores), fewer if their count tables
+     * would exceed counts_budget together.
+     */
+    static counts count_files(const std::vector<std::string>& paths, size_t threads) {
+        std::vector<std::unique_ptr<mapped_file>> files;
+        std::vector<piece> pieces;
+        for (const auto& path : paths) {
+            files.push_back(std::make_unique<mapped_file>(path));
+            const mapped_file& file = *files.back();
+            file.advise_sequential();
+            for (size_t begin = 0; begin < file.size();) {
+                size_t end = std::min(begin + piece_size, file.size());
+                while (end < file.size() && is_continuation(file.data()[end])) {
+                    ++end;
+                }
+                pieces.push_back({&file, begin, end});
+                begin = end;
+            }
+        }
+
+        size_t table_bytes = 0;
+        for (size_t order = 1; order <= max_order; ++order) {
+            table_bytes += ngram_tables::entries(size, order) * sizeof(uint64_t);
+        }
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::max<size_t>(1, std::min({threads, counts_budget / table_bytes, pieces.size()}));
+
+        std::vector<counts> partial(threads);
+        std::atomic<size_t> next{0};
+        for_each_chunk(chunk_bounds(threads, threads, 1), [&](size_t worker, size_t, size_t) {
+            partial[worker] = empty_counts();
+            std::vector<uint8_t> indices;
+            for (size_t i = next.fetch_add(1); i < pieces.size(); i = next.fetch_add(1)) {
+                size_t own = decode(pieces[i], indices);
+                count(indices, own, partial[worker]);
+            }
+        });
+
+        counts result = std::move(partial[0]);
+        for (size_t order = 1; order <= max_order; ++order) {
+            std::vector<uint64_t>& total = result[order - 1];
+            for_each_chunk(chunk_bounds(total.size(), threads), [&](size_t, size_t begin, size_t end) {
+                for (size_t worker = 1; worker < threads; ++worker) {
+                    const std::vector<uint64_t>& add = partial[worker][order - 1];
+                    for (size_t i = begin; i < end; ++i) {
+                        total[i] += add[i];
+                    }
+                }
+            });
+        }
+        return result;
+    }
+
+    //log10 probabilities of the counts of every order, see ngram_tables for the score of unseen n-grams
+    static std::array<std::vector<float>, max_order> score(const counts& totals) {
+        std::array<std::vector<float>, max_order> result;
+        for (size_t order = 1; order <= max_order; ++order) {
+            const std::vector<uint64_t>& counted = totals[order - 1];
+            uint64_t total = 0;
+            for (uint64_t value : counted) {
+                total += value;
+            }
+            if (total == 0) {
+                throw std::runtime_error("Training text too short");
+            }
+            std::vector<float>& scores = result[order - 1];
+            scores.resize(counted.size());
+            const double unseen = std::log10(0.01 / double(total));
+            for (size_t i = 0; i < counted.size(); ++i) {
+                scores[i] = float(counted[i] != 0 ? std::log10(double(counted[i]) / double(total)) : unseen);
+            }
+        }
+        return result;
+    }
+
+    static std::vector<uint32_t> alphabet() {
+        std::vector<uint32_t> result;
+        for (size_t i = 0; i < size; ++i) {
+            result.push_back(uint32_t(Alphabet::symbol_at(i)));
+        }
+        return result;
+    }
+};
+
+}
@@ -4,59 +4,13 @@
 #include <codecvt>
 #include <locale>
 #include <iomanip>
+#include <vector>
+#include <cstring>
+#include "polyalphabetic.h"
+#include "pipeline.h"
 
 using namespace std;
-
-const wchar_t allowed_symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯABCDEFGIJKLMNOPQRSTUVWXYZ0123456789 \"-*";
-//const wchar_t allowed_symbols[] = L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ";
-
-class encryptor {
-    wstring key;
-    int key_index;
-    unordered_map<wchar_t, int> index_cache;
-    const int set_size = wcslen(allowed_symbols);
-
-public:
-    encryptor(wstring key, const unordered_map<wchar_t, int>& indexCache)
-        : key(move(key)), index_cache(indexCache), key_index(0) {}
-
-    wchar_t operator()(const wchar_t& symbol) {
-        int input_symbol_index = index_cache.at(symbol);
-        if (key_index == key.size()) {
-            key_index -= key.size();
-        }
-        int key_symbol_index = index_cache.at(key[key_index++]);
-
-        int result_index = (input_symbol_index + key_symbol_index) % set_size;
-
-        return allowed_symbols[result_index];
-    }
-};
-
-class decryptor {
-    wstring key;
-    int key_index;
-    unordered_map<wchar_t, int> index_cache;
-    const int set_size = wcslen(allowed_symbols);
-
-public:
-    decryptor(wstring key, const unordered_map<wchar_t, int>& indexCache)
-        : key(move(key)), index_cache(indexCache), key_index(0) {}
-
-    wchar_t operator()(const wchar_t& symbol) {
-        int input_symbol_index = index_cache.at(symbol);
-        if (key_index == key.size()) {
-            key_index -= key.size();
-        }
-        int key_symbol_index = index_cache.at(key[key_index++]);
-
-        int result_index = (input_symbol_index - key_symbol_index + set_size) % set_size;
-
-        return allowed_symbols[result_index];
-    }
-};
-
-enum Operation { Encrypt = 1, Decrypt };
+using namespace polyalphabetic;
 
 inline istream& operator>>(istream& in, Operation& op) {
     int val;
@@ -67,8 +21,13 @@ inline istream& operator>>(istream& in, Operation& op) {
 
 //necessary because Windows doesn't natively support wide character streams
 inline ostream& operator<<(ostream& out, const wstring& utf16) {
-    wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
-    string utf8 = converter.to_bytes(utf16);
+    string utf8;
+    {
+        INSTRUMENT_STAGE("utf8_encode", utf16.size() * sizeof(wchar_t));
+        wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
+        utf8 = converter.to_bytes(utf16);
+    }
+    INSTRUMENT_STAGE("output", utf8.size());
     out << utf8;
     return out;
 }
@@ -87,104 +46,58 @@ inline istream& operator>>(istream& in, wstring& utf16) {
     string utf8;
     getline(cin, utf8);
     if (!utf8.empty()) {
+        INSTRUMENT_STAGE("utf8_decode", utf8.size());
         utf16 = converter.from_bytes(utf8);
     }
     return in;
 }
 
-class cipher_worker {
-
-    unordered_map<wchar_t, int> index_cache;
-
-    /**
-     * padding algorithm:
-     *  text: abc
-     *  1st iteration: *abc
-     *  2nd iteration: *abc*
-     *  3rd iteration: **abc*
-     *  ...
-    */
-    static void pad_input(wstring& input, const wstring& key) {
-        if (input.size() % key.size() == 0) {
-            return;
-        }
-        size_t times = key.size() - (input.size() % key.size());
-        if (times % 2 == 0) {
-            input.insert(0, times / 2, '*');
-        } else {
-            input.insert(0, (times / 2) + 1, '*');
-        }
-        fill_n(back_inserter(input), times / 2, '*');
-    }
-
-    void validate_input(const wstring& input, const wstring& key) {
-        if (input.size() > 300) {
-            throw runtime_error("Illegal input length");
-        }
+/**
+ * Non-interactive mode for whole files: every line of stdin is a message ciphered from the start of the key,
+ * see pipeline.h. Unlike the interactive mode the lines are not padded with '*'.
+ */
+int stream(Operation operation, const string& key_utf8) {
+    try {
+        vector<indexed_text::index_type> key(utf8::max_decoded(key_utf8.size()));
+        key.resize(indexed_text::decode<symbols_type>(key_utf8.data(), key_utf8.data() + key_utf8.size(), key.data()));
         if (key.empty()) {
             throw runtime_error("No key provided");
         }
-        if (key.size() > input.size()) {
-            throw runtime_error("Illegal key length");
-        }
-        auto contained_in_set = [&](auto& symbol) { return index_cache.find(symbol) != index_cache.end(); };
-        if (!all_of(input.begin(), input.end(), contained_in_set) ||
-                !all_of(key.begin(), key.end(), contained_in_set)) {
-            throw runtime_error("Illegal symbol detected");
-        }
-    }
-
-    static void trim_asterisks(wstring& result) {
-        if (result.empty()) {
-            return;
-        }
-        while (*result.begin() == L'*') {
-            result.erase(0, 1);
-        }
-        while (*--result.end() == L'*') {
-            result.erase(--result.end());
-        }
+        pipeline::run<symbols_type>(STDIN_FILENO, STDOUT_FILENO, [&](auto begin, auto end, auto out) {
+            cipher_into(begin, end, operation, key.data(), key.size(), out);
+        });
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
     }
+    return 0;
+}
 
-public:
-    explicit cipher_worker(const unordered_map<wchar_t, int>& indexCache) : index_cache(indexCache) {}
-
-    wstring operator()(wstring& input, Operation operation, const wstring& key) {
-        validate_input(input, key);
-        pad_input(input, key);
-
-        wstring result;
-        if (operation == Encrypt) {
-            transform(input.begin(), input.end(), back_inserter(result), encryptor(key, index_cache));
-        } else {
-            transform(input.begin(), input.end(), back_inserter(result), decryptor(key, index_cache));
-            trim_asterisks(result);
-        }
-
-        return result;
+//byte mode: stdin as raw bytes, the key as the raw bytes of its argument, over the 256 symbol byte alphabet
+int stream_bytes(Operation operation, const string& key) {
+    try {
+        auto key_bytes = reinterpret_cast<const uint8_t*>(key.data());
+        pipeline::run_bytes(STDIN_FILENO, STDOUT_FILENO, [&](auto begin, auto end, auto out, size_t offset) {
+            cipher_bytes(begin, end, operation, key_bytes, key.size(), out, offset);
+        });
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
     }
+    return 0;
+}
 
-    static double compute_frequency_coefficient(const wstring& result) {
-        unordered_map<wchar_t, int> frequency;
-        for (auto& ch : result) {
-            ++frequency[ch];
-        }
-        int frequency_sum = 0;
-        for (auto& [ch, freq] : frequency) {
-            frequency_sum += freq * (freq - 1);
+int main(int argc, char* argv[]) {
+    if (argc == 4 && (strcmp(argv[1], "--stream") == 0 || strcmp(argv[1], "--bytes") == 0)) {
+        auto operation = static_cast<Operation>(atoi(argv[2]));
+        if (operation != Encrypt && operation != Decrypt) {
+            cerr << "Usage: CryptoPolyalphabeticSubstitution --stream|--bytes 1|2 key < input > output" << endl;
+            return 2;
         }
-        return double(frequency_sum) / double(result.size() * (result.size() - 1));
-    }
-};
-
-int main() {
-    unordered_map<wchar_t, int> indexCache;
-    int n = wcslen(allowed_symbols);
-    for (int i = 0; i < n; i++) {
-        indexCache.emplace(allowed_symbols[i], i);
+        return strcmp(argv[1], "--bytes") == 0 ? stream_bytes(operation, argv[3]) : stream(operation, argv[3]);
     }
 
-    cipher_worker worker(indexCache);
+    cipher_worker worker;
 
     cout << "Enter input: ";
     wstring input;
@@ -202,7 +115,7 @@ int main() {
         try {
             wstring result = worker(input, operation, key);
 
-//            double frequency_coeff = cipher_worker::compute_frequency_coefficient(result);
+//            double frequency_coeff = cipher_worker<>::compute_frequency_coefficient(result);
 //            cout << "Frequency coefficient: " << setprecision(4) << frequency_coeff << endl;
 
             cout << result << endl;
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "alphabet.h"
+#include "autotune.h"
+#include "compose.h"
+#include "indexed_text.h"
+#include "byte_alphabet.h"
+#include "parallel_transform.h"
+#include "frequency.h"
+#include "instrumentation.h"
+
+namespace polyalphabetic {
+
+//L"АБВГДЕЖЗИЙКЛМНОПРСТУФХЦЧШЩЪЬЮЯ" is used as well, it needs its own traits in alphabet.h
+using symbols_type = alphabets::cyrillic_latin;
+constexpr const auto& allowed_symbols = alphabets::cyrillic_latin_traits::symbols;
+
+template<typename Alphabet = symbols_type>
+class encryptor {
+    //not owned, the key has to outlive the functor
+    std::wstring_view key;
+    size_t key_index;
+    //offset of the next symbol in the whole text, reported for symbols outside the alphabet
+    size_t position;
+
+public:
+    //key_offset: position of the first symbol in the whole text, lets a chunk start mid-key
+    explicit encryptor(std::wstring_view key, size_t key_offset = 0)
+        : key(key), key_index(key.empty() ? 0 : key_offset % key.size()), position(key_offset) {}
+
+    //validates the symbol while ciphering it, throws illegal_symbol with its offset
+    wchar_t operator()(const wchar_t& symbol) {
+        int input_symbol_index = Alphabet::checked_index_of(symbol, position++);
+        if (key_index == key.size()) {
+            key_index -= key.size();
+        }
+        int key_symbol_index = Alphabet::checked_index_of(key[key_index++]);
+
+        int result_index = (input_symbol_index + key_symbol_index) % Alphabet::size;
+
+        return Alphabet::symbol_at(result_index);
+    }
+};
+
+template<typename Alphabet = symbols_type>
+class decryptor {
+    //not owned, the key has to outlive the functor
+    std::wstring_view key;
+    size_t key_index;
+    //offset of the next symbol in the whole text, reported for symbols outside the alphabet
+    size_t position;
+
+public:
+    //key_offset: position of the first symbol in the whole text, lets a chunk start mid-key
+    explicit decryptor(std::wstring_view key, size_t key_offset = 0)
+        : key(key), key_index(key.empty() ? 0 : key_offset % key.size()), position(key_offset) {}
+
+    //validates the symbol while ciphering it, throws illegal_symbol with its offset
+    wchar_t operator()(const wchar_t& symbol) {
+        int input_symbol_index = Alphabet::checked_index_of(symbol, position++);
+        if (key_index == key.size()) {
+            key_index -= key.size();
+        }
+        int key_symbol_index = Alphabet::checked_index_of(key[key_index++]);
+
+        int result_index = (input_symbol_index - key_symbol_index + Alphabet::size) % Alphabet::size;
+
+        return Alphabet::symbol_at(result_index);
+    }
+};
+
+enum Operation { Encrypt = 1, Decrypt };
+
+/**
+ * Index form of the functors, for text and key decoded with indexed_text: ciphers the alphabet indices
+ * [begin, end) into out. key_offset is the key position of the first symbol, as for the functors.
+ * Keys up to max_period symbols are repeated into a stack buffer of whole key periods, so the
+ * inner loop is a plain byte add over equal length arrays that the compiler vectorizes.
+ */
+template<typename Alphabet = symbols_type>
+void cipher_into(const indexed_text::index_type* begin, const indexed_text::index_type* end, Operation operation,
+                 const indexed_text::index_type* key, size_t key_size, indexed_text::index_type* out,
+                 size_t key_offset = 0) {
+    INSTRUMENT_STAGE("polyalphabetic.cipher_indices", end - begin);
+    if (key_size == 0) {
+        throw std::runtime_error("No key provided");
+    }
+    constexpr size_t max_period = 128;
+    const size_t length = end - begin;
+    //decryption adds size - key, so both directions are one addition and one conditional subtraction
+    auto shift_at = [&](size_t key_index) {
+        uint8_t shift = key[key_index];
+        return uint8_t(operation == Encrypt || shift == 0 ? shift : Alphabet::size - shift);
+    };
+    auto add = [](uint8_t index, uint8_t shift) {
+        uint8_t sum = index + shift;
+        return uint8_t(sum >= Alphabet::size ? sum - Alphabet::size : sum);
+    };
+
+    if (key_size > max_period) {
+        size_t key_index = key_offset % key_size;
+        for (size_t i = 0; i < length; ++i) {
+            out[i] = add(begin[i], shift_at(key_index));
+            if (++key_index == key_size) {
+                key_index = 0;
+            }
+        }
+        return;
+    }
+
+    const size_t period = max_period / key_size * key_size;
+    uint8_t shifts[max_period];
+    for (size_t j = 0; j < period; ++j) {
+        shifts[j] = shift_at((key_offset + j) % key_size);
+    }
+    size_t i = 0;
+    for (; i + period <= length; i += period) {
+        for (size_t j = 0; j < period; ++j) {
+            out[i + j] = add(begin[i + j], shifts[j]);
+        }
+    }
+    for (size_t j = 0; i + j < length; ++j) {
+        out[i + j] = add(begin[i + j], shifts[j]);
+    }
+}
+
+/**
+ * Encryption as a compose::map stage over alphabet indices: ciphers a range of the text in place with
+ * cipher_into, starting at the key position of its first symbol. The key has to outlive the stage.
+ */
+template<typename Alphabet = symbols_type>
+class index_encryptor {
+    const indexed_text::index_type* key;
+    size_t key_size;
+
+public:
+    index_encryptor(const indexed_text::index_type* key, size_t key_size) : key(key), key_size(key_size) {}
+
+    void operator()(indexed_text::index_type* symbols, size_t count, size_t first) const {
+        cipher_into<Alphabet>(symbols, symbols + count, Encrypt, key, key_size, symbols, first);
+    }
+};
+
+/**
+ * Byte mode: the Vigenère cipher over the 256 symbol byte_alphabet, for raw bytes and raw byte keys.
+ * Nothing is decoded or validated; key_offset is the key position of the first byte.
+ */
+inline void cipher_bytes(const uint8_t* begin, const uint8_t* end, Operation operation, const uint8_t* key,
+                         size_t key_size, uint8_t* out, size_t key_offset = 0) {
+    INSTRUMENT_STAGE("polyalphabetic.cipher_bytes", end - begin);
+    if (key_size == 0) {
+        throw std::runtime_error("No key provided");
+    }
+    byte_alphabet::add_key(begin, end - begin, key, key_size, key_offset, out, operation == Decrypt);
+}
+
+/**
+ * Splits the text into chunks and ciphers them on separate threads.
+ * The key position of a symbol is its offset modulo the key length, so every chunk starts its
+ * functor at that position and the result matches the sequential transform exactly.
+ */
+template<typename Alphabet = symbols_type>
+std::wstring parallel_cipher(const std::wstring& input, Operation operation, const std::wstring& key,
+                             size_t threads = 0) {
+    INSTRUMENT_STAGE("polyalphabetic.parallel_cipher", input.size() * sizeof(wchar_t));
+    if (operation == Encrypt) {
+        return parallel_transform(input, [&](size_t, size_t begin) { return encryptor<Alphabet>(key, begin); }, threads);
+    }
+    return parallel_transform(input, [&](size_t, size_t begin) { return decryptor<Alphabet>(key, begin); }, threads);
+}
+
+/**
+ * Ciphers [begin, end) into out with the kernel of strategy: the functors, the index kernel over decoded blocks
+ * or that on all cores. A key with symbols outside the alphabet takes the functors, which report the first
+ * invalid symbol of text or key in the order they meet them.
+ */
+template<typename Alphabet = symbols_type>
+void cipher_with(autotune::strategy strategy, const wchar_t* begin, const wchar_t* end, Operation operation,
+                 std::wstring_view key, wchar_t* out) {
+    if (key.empty()) {
+        throw std::runtime_error("No key provided");
+    }
+    std::vector<indexed_text::index_type> key_indices;
+    if (strategy != autotune::SCALAR) {
+        for (wchar_t symbol : key) {
+            int index = Alphabet::index_of(symbol);
+            if (index == -1) {
+                strategy = autotune::SCALAR;
+                break;
+            }
+            key_indices.push_back(indexed_text::index_type(index));
+        }
+    }
+    if (strategy == autotune::SCALAR) {
+        if (operation == Encrypt) {
+            std::transform(begin, end, out, encryptor<Alphabet>(key));
+        } else {
+            std::transform(begin, end, out, decryptor<Alphabet>(key));
+        }
+        return;
+    }
+    autotune::through_indices<Alphabet>(strategy, begin, end, out, [&](auto in, auto in_end, auto to, size_t first) {
+        cipher_into<Alphabet>(in, in_end, operation, key_indices.data(), key_indices.size(), to, first);
+    });
+}
+
+//the text ciphered with the kernel autotune measured fastest for its size on this machine, unpadded
+template<typename Alphabet = symbols_type>
+std::wstring cipher(const std::wstring& input, Operation operation, const std::wstring& key) {
+    autotune::strategy strategy = autotune::choose<Alphabet>(
+        "polyalphabetic", input.size(), autotune::all_strategies,
+        [](autotune::strategy kind, auto begin, auto end, auto out) {
+            const wchar_t sample_key[] = {Alphabet::symbol_at(7), Alphabet::symbol_at(1), Alphabet::symbol_at(4)};
+            cipher_with<Alphabet>(kind, begin, end, Encrypt, std::wstring_view(sample_key, 3), out);
+        });
+    std::wstring result(input.size(), L'\0');
+    cipher_with<Alphabet>(strategy, input.data(), input.data() + input.size(), operation, key,
+                          &result[0]);
+    return result;
+}
+
+template<typename Alphabet = symbols_type>
+class cipher_worker {
+
+    /**
+     * padding algorithm:
+     *  text: abc
+     *  1st iteration: *abc
+     *  2nd iteration: *abc*
+     *  3rd iteration: **abc*
+     *  ...
+     * The padding is never materialized, cipher_into ciphers the '*' symbols on the fly.
+    */
+    static size_t left_padding(size_t input_size, size_t key_size) {
+        size_t times = (key_size - input_size % key_size) % key_size;
+        return times - times / 2;
+    }
+
+    void validate_input(std::wstring_view input, std::wstring_view key) {
+        INSTRUMENT_STAGE("polyalphabetic.validate", (input.size() + key.size()) * sizeof(wchar_t));
+        if (input.size() > 300) {
+            throw std::runtime_error("Illegal input length");
+        }
+        if (key.empty()) {
+            throw std::runtime_error("No key provided");
+        }
+        if (key.size() > input.size()) {
+            throw std::runtime_error("Illegal key length");
+        }
+        //the input symbols are checked by the functors while they cipher them
+        if (!std::all_of(key.begin(), key.end(), [](auto& symbol) { return Alphabet::contains(symbol); })) {
+            throw std::runtime_error("Illegal symbol detected");
+        }
+    }
+
+    template<typename Functor>
+    static wchar_t* cipher_padded(const wchar_t* begin, const wchar_t* end, size_t key_size, Functor functor,
+                                  wchar_t* out) {
+        size_t left = left_padding(end - begin, key_size);
+        size_t right = padded_size(end - begin, key_size) - (end - begin) - left;
+        for (size_t i = 0; i < left; ++i) {
+            *out++ = functor(L'*');
+        }
+        //not std::transform, it would advance a copy of the functor's key position
+        for (const wchar_t* it = begin; it != end; ++it) {
+            *out++ = functor(*it);
+        }
+        for (size_t i = 0; i < right; ++i) {
+            *out++ = functor(L'*');
+        }
+        return out;
+    }
+
+    //moves the result without its leading and trailing '*' to the front of the buffer, returns its length
+    static size_t trim_asterisks(wchar_t* begin, wchar_t* end) {
+        const wchar_t* first = std::find_if(begin, end, [](wchar_t symbol) { return symbol != L'*'; });
+        while (end != first && *(end - 1) == L'*') {
+            --end;
+        }
+        if (first != begin) {
+            std::copy(first, static_cast<const wchar_t*>(end), begin);
+        }
+        return end - first;
+    }
+
+public:
+    //room cipher_into needs for an input of input_size symbols
+    static size_t padded_size(size_t input_size, size_t key_size) {
+        if (key_size == 0) {
+            return input_size;
+        }
+        return input_size + (key_size - input_size % key_size) % key_size;
+    }
+
+    /**
+     * The padded encryption of cipher_into as a compose view over alphabet indices decoded with indexed_text,
+     * for chaining it into a transposition without materializing it. Symbols are ciphered when read.
+     */
+    static auto encrypt_view(const indexed_text::index_type* begin, const indexed_text::index_type* end,
+                             const indexed_text::index_type* key, size_t key_size) {
+        if (key_size == 0) {
+            throw std::runtime_error("No key provided");
+        }
+        constexpr auto asterisk = indexed_text::index_type(Alphabet::index_of(L'*'));
+        const size_t length = end - begin;
+        auto padded = compose::pad(compose::span_view<indexed_text::index_type>(begin, end),
+                                   left_padding(length, key_size), padded_size(length, key_size), asterisk);
+        return compose::map(padded, index_encryptor<Alphabet>(key, key_size));
+    }
+
+    /**
+     * Ciphers [begin, end) with its padding into out, which has room for padded_size symbols.
+     * Returns the number of symbols written; decryption trims the padding. Does not allocate.
+     */
+    size_t cipher_into(const wchar_t* begin, const wchar_t* end, Operation operation, std::wstring_view key,
+                       wchar_t* out) {
+        INSTRUMENT_STAGE("polyalphabetic.cipher", (end - begin) * sizeof(wchar_t));
+        validate_input(std::wstring_view(begin, end - begin), key);
+
+        try {
+            if (operation == Encrypt) {
+                return cipher_padded(begin, end, key.size(), encryptor<Alphabet>(key), out) - out;
+            }
+            wchar_t* result_end = cipher_padded(begin, end, key.size(), decryptor<Alphabet>(key), out);
+            return trim_asterisks(out, result_end);
+        } catch (const illegal_symbol& e) {
+            //the functors count the left padding, report the offset in the caller's input
+            throw illegal_symbol(e.offset() - left_padding(end - begin, key.size()), e.code_point());
+        }
+    }
+
+    std::wstring operator()(const std::wstring& input, Operation operation, const std::wstring& key) {
+        std::wstring result(padded_size(input.size(), key.size()), L'\0');
+        result.resize(cipher_into(input.data(), input.data() + input.size(), operation, key, &result[0]));
+        return result;
+    }
+
+    static double compute_frequency_coefficient(const std::wstring& result) {
+        histogram<Alphabet> frequency;
+        frequency.add(result);
+        return frequency.index_of_coincidence();
+    }
+};
+
+}
@@ -0,0 +1,382 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "mapped_file.h"
+#include "work_stealing_pool.h"
+#include "protocol.h"
+#include "dispatcher.h"
+
+/**
+ * Batch mode: ciphers whole directory trees with one cipher and key, writing every output to the same
+ * relative path under the output directory.
+ *
+ * Every file is a task of a work_stealing_pool. A file larger than the split size is cut into parts of about
+ * that size, at line breaks in line mode, which the task submits as sub-tasks; idle workers steal them, so one
+ * huge file does not leave the other workers waiting. The part finishing last writes the file.
+ * Line mode ciphers every line as a message of its own through the service dispatcher and copies the line
+ * breaks, like the --stream mode of the exercises. Byte mode (--bytes, Caesar and polyalphabetic) ciphers
+ * the file as one message over the byte alphabet, every part at its offset straight into the output file.
+ */
+
+namespace fs = std::filesystem;
+using clock_type = std::chrono::steady_clock;
+
+constexpr const size_t DEFAULT_SPLIT_SIZE = 4 << 20;
+
+struct settings {
+    uint8_t cipher = 0;
+    uint8_t operation = 0;
+    std::string key;
+    bool bytes = false;
+    size_t split_size = DEFAULT_SPLIT_SIZE;
+};
+
+struct statistics {
+    std::mutex mutex;
+    std::vector<double> latencies_ns;
+    size_t failed = 0;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+};
+
+//first error of a file, by the part it happened in
+struct part_error {
+    size_t part = SIZE_MAX;
+    //line in the part, line mode only
+    size_t line = 0;
+    std::string message;
+};
+
+struct file_job {
+    fs::path input;
+    fs::path output;
+    clock_type::time_point started;
+    std::unique_ptr<mapped_file> data;
+    //[bounds[i], bounds[i + 1]) is part i
+    std::vector<size_t> bounds;
+    //line mode: the output of every part
+    std::vector<std::string> results;
+    //byte mode: the output file, written by the parts
+    int output_fd = -1;
+    std::atomic<size_t> remaining{0};
+    std::mutex error_mutex;
+    part_error error;
+
+    void fail(size_t part, size_t line, const std::string& message) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (part < error.part) {
+            error = {part, line, message};
+        }
+    }
+};
+
+void write_at(int fd, const char* data, size_t size, off_t offset) {
+    while (size != 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error(std::string("Cannot write output: ") + strerror(errno));
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+int open_output(const fs::path& path) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path.string() + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+//part boundaries of about split_size bytes; in line mode every part but the last ends with a line break
+std::vector<size_t> split(const char* data, size_t size, size_t split_size, bool whole_lines) {
+    std::vector<size_t> bounds{0};
+    while (bounds.back() < size) {
+        size_t end = std::min(size, bounds.back() + split_size);
+        if (whole_lines && end < size) {
+            const void* line_break = std::memchr(data + end - 1, '\n', size - end + 1);
+            end = line_break ? static_cast<const char*>(line_break) - data + 1 : size;
+        }
+        bounds.push_back(end);
+    }
+    return bounds;
+}
+
+class batch {
+    const settings config;
+    work_stealing_pool& pool;
+    statistics& stats;
+
+    void run_lines(file_job& job, size_t part) {
+        const char* begin = job.data->data() + job.bounds[part];
+        const char* end = job.data->data() + job.bounds[part + 1];
+        std::string& result = job.results[part];
+        request req;
+        req.cipher = config.cipher;
+        req.operation = config.operation;
+        req.key = config.key;
+        size_t line = 0;
+        try {
+            for (const char* it = begin; it != end; ++line) {
+                const char* line_end = std::find(it, end, '\n');
+                req.payload.assign(it, line_end);
+                result += dispatch(req);
+                if (line_end != end) {
+                    result += '\n';
+                    ++line_end;
+                }
+                it = line_end;
+            }
+        } catch (const std::exception& e) {
+            job.fail(part, line, e.what());
+        }
+    }
+
+    void run_bytes(file_job& job, size_t part) {
+        thread_local std::vector<uint8_t> buffer;
+        const size_t offset = job.bounds[part];
+        const size_t size = job.bounds[part + 1] - offset;
+        auto begin = reinterpret_cast<const uint8_t*>(job.data->data() + offset);
+        buffer.resize(size);
+        try {
+            if (config.cipher == CAESAR) {
+                caesar::cipher_bytes(begin, begin + size, buffer.data(), caesar::Operation(config.operation));
+            } else {
+                auto key = reinterpret_cast<const uint8_t*>(config.key.data());
+                polyalphabetic::cipher_bytes(begin, begin + size, polyalphabetic::Operation(config.operation), key,
+                                             config.key.size(), buffer.data(), offset);
+            }
+            write_at(job.output_fd, reinterpret_cast<const char*>(buffer.data()), size, off_t(offset));
+        } catch (const std::exception& e) {
+            job.fail(part, 0, e.what());
+        }
+    }
+
+    //writes the line mode output, closes the file and records the result; called once the last part is done
+    void finish(file_job& job) {
+        uint64_t written = job.bounds.back();
+        try {
+            if (job.output_fd == -1 && job.error.message.empty()) {
+                job.output_fd = open_output(job.output);
+                written = 0;
+                for (const auto& result : job.results) {
+                    write_at(job.output_fd, result.data(), result.size(), off_t(written));
+                    written += result.size();
+                }
+            }
+        } catch (const std::exception& e) {
+            job.fail(0, 0, e.what());
+        }
+        if (job.output_fd != -1) {
+            ::close(job.output_fd);
+        }
+        double latency = std::chrono::duration<double, std::nano>(clock_type::now() - job.started).count();
+
+        std::string where;
+        if (!job.error.message.empty() && !config.bytes && job.error.part < job.results.size()) {
+            //counted only now, so the parts do not need to know the line they start at
+            const char* data = job.data->data();
+            size_t line = job.error.line + 1 + std::count(data, data + job.bounds[job.error.part], '\n');
+            where = "Line " + std::to_string(line) + ": ";
+        }
+        //the file is done with, so its mapping and line mode output go now, not when the run ends
+        job.data.reset();
+        job.results = {};
+
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        if (!job.error.message.empty()) {
+            std::cerr << job.input.string() << ": " << where << job.error.message << std::endl;
+            ++stats.failed;
+            std::error_code ignored;
+            fs::remove(job.output, ignored);
+            return;
+        }
+        stats.latencies_ns.push_back(latency);
+        stats.input_bytes += job.bounds.back();
+        stats.output_bytes += written;
+    }
+
+    void run_part(const std::shared_ptr<file_job>& job, size_t part) {
+        if (config.bytes) {
+            run_bytes(*job, part);
+        } else {
+            run_lines(*job, part);
+        }
+        if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish(*job);
+        }
+    }
+
+public:
+    batch(settings config, work_stealing_pool& pool, statistics& stats)
+        : config(std::move(config)), pool(pool), stats(stats) {}
+
+    //maps the file, splits it and runs the first part itself, the others as sub-tasks
+    void run_file(const std::shared_ptr<file_job>& job) {
+        job->started = clock_type::now();
+        try {
+            job->data = std::make_unique<mapped_file>(job->input.string());
+            fs::create_directories(job->output.parent_path());
+            job->bounds = split(job->data->data(), job->data->size(), config.split_size, !config.bytes);
+            if (config.bytes) {
+                job->output_fd = open_output(job->output);
+            }
+        } catch (const std::exception& e) {
+            job->bounds = {0};
+            job->fail(0, 0, e.what());
+            finish(*job);
+            return;
+        }
+        const size_t parts = job->bounds.size() - 1;
+        if (parts == 0) {
+            finish(*job);
+            return;
+        }
+        job->results.resize(config.bytes ? 0 : parts);
+        job->remaining.store(parts, std::memory_order_relaxed);
+        for (size_t part = 1; part < parts; ++part) {
+            pool.submit([this, job, part]() { run_part(job, part); });
+        }
+        run_part(job, 0);
+    }
+};
+
+/**
+ * Every regular file under the inputs, with its output path: relative to a directory input, by name for a file.
+ * Throws when two inputs map to the same output path, their tasks would write the same file.
+ */
+std::vector<std::shared_ptr<file_job>> collect(const std::vector<std::string>& inputs, const fs::path& output) {
+    std::vector<std::shared_ptr<file_job>> jobs;
+    std::unordered_map<std::string, fs::path> inputs_by_target;
+    auto add = [&](const fs::path& input, const fs::path& target) {
+        auto [existing, added] = inputs_by_target.emplace(target.lexically_normal().string(), input);
+        if (!added) {
+            throw std::runtime_error("Same output " + target.string() + " for " + existing->second.string() +
+                                     " and " + input.string());
+        }
+        auto job = std::make_shared<file_job>();
+        job->input = input;
+        job->output = target;
+        jobs.push_back(std::move(job));
+    };
+    for (const auto& input : inputs) {
+        if (fs::is_directory(input)) {
+            for (const auto& entry : fs::recursive_directory_iterator(input)) {
+                if (entry.is_regular_file()) {
+                    add(entry.path(), output / fs::relative(entry.path(), input));
+                }
+            }
+        } else if (fs::is_regular_file(input)) {
+            add(input, output / fs::path(input).filename());
+        } else {
+            throw std::runtime_error("No such file or directory: " + input);
+        }
+    }
+    return jobs;
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoBatch --cipher name --operation 1|2 [--key key] [--bytes] --output directory\n"
+                 "                   [--threads count] [--split-size bytes] file|directory...\n"
+                 "Ciphers: caesar, direct_substitution, polyalphabetic, matrix_substitution, block_transposition,\n"
+                 "         column_transposition, zorge, zorge_block, polyalphabetic_column\n"
+                 "--bytes ciphers raw bytes (caesar and polyalphabetic), otherwise every line is a message."
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    settings config;
+    std::string cipher;
+    std::string output;
+    size_t threads = std::thread::hardware_concurrency();
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            inputs.push_back(arg);
+            continue;
+        }
+        if (arg == "--bytes") {
+            config.bytes = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--cipher") {
+            cipher = value;
+        } else if (arg == "--operation") {
+            config.operation = std::stoi(value);
+        } else if (arg == "--key") {
+            config.key = value;
+        } else if (arg == "--output") {
+            output = value;
+        } else if (arg == "--threads") {
+            threads = std::stoul(value);
+        } else if (arg == "--split-size") {
+            config.split_size = std::max<size_t>(1, std::stoul(value));
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    config.cipher = cipher_by_name(cipher);
+    bool byte_cipher = config.cipher == CAESAR || (config.cipher == POLYALPHABETIC && !config.key.empty());
+    if (config.cipher == 0 || (config.operation != caesar::Encrypt && config.operation != caesar::Decrypt) ||
+        output.empty() || inputs.empty() || (config.bytes && !byte_cipher)) {
+        print_usage();
+        return 2;
+    }
+
+    statistics stats;
+    size_t files = 0;
+    auto start = clock_type::now();
+    try {
+        auto jobs = collect(inputs, output);
+        files = jobs.size();
+        work_stealing_pool pool(threads);
+        batch runner(config, pool, stats);
+        //the pool holds the only reference, so a job is freed as soon as its last task is done
+        for (auto& job : jobs) {
+            pool.submit([&runner, job = std::move(job)]() { runner.run_file(job); });
+        }
+        jobs = {};
+        pool.wait();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    auto& latencies = stats.latencies_ns;
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, size_t(latencies.size() * p))];
+    };
+    std::cout << "{\"cipher\":\"" << cipher << "\",\"files\":" << files << ",\"failed\":" << stats.failed
+              << ",\"input_bytes\":" << stats.input_bytes << ",\"output_bytes\":" << stats.output_bytes
+              << ",\"seconds\":" << seconds << ",\"mb_per_s\":" << stats.input_bytes / 1e6 / seconds
+              << ",\"files_per_s\":" << files / seconds << ",\"p50_ns\":" << percentile(0.5)
+              << ",\"p90_ns\":" << percentile(0.9) << ",\"p99_ns\":" << percentile(0.99)
+              << ",\"max_ns\":" << (latencies.empty() ? 0 : latencies.back())
+              << "}" << std::endl;
+    return stats.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string_view>
+#include "compose.h"
+#include "indexed_text.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+#include "CryptoBlockTransposition/block_transposition.h"
+#include "CryptoColumnTransposition/column_transposition.h"
+#include "CryptoZorgeCypher/checkerboard.h"
+
+/**
+ * Cipher chains run as one pass, without the intermediate text of every stage.
+ * Each stage validates only what it reads from outside the chain: the first one its input,
+ * the transpositions their keys.
+ */
+namespace chains {
+
+//room zorge_block needs for an input of input_size formatted symbols
+inline size_t zorge_block_size(size_t input_size, size_t key_size) {
+    return block_transposition::encrypted_size(input_size * zorge::max_code_chars, key_size);
+}
+
+/**
+ * Checkerboard codes of the formatted text, block transposed with block_key as they are produced.
+ * The digits are padded with spaces to whole blocks. Returns the number of characters written.
+ */
+inline size_t zorge_block(const char* begin, const char* end, const zorge::encryptor::checkerboard& board,
+                          std::wstring_view block_key, char* out) {
+    auto writer = zorge::encryptor::encrypt_to(begin, end, board,
+                                               block_transposition::block_writer<char>(block_key, out));
+    return writer.finish(' ') - out;
+}
+
+//room polyalphabetic_column needs for an input of input_size symbols
+inline size_t polyalphabetic_column_size(size_t input_size, size_t key_size, size_t column_key_size) {
+    using worker = polyalphabetic::cipher_worker<>;
+    return column_transposition::encrypted_size(worker::padded_size(input_size, key_size), column_key_size);
+}
+
+/**
+ * The padded Vigenère encryption of cipher_worker, column transposed with column_key, over polyalphabetic
+ * alphabet indices. The transposition reads every symbol of the padded text once and the substitution
+ * is computed in that read. Returns the number of indices written.
+ */
+inline size_t polyalphabetic_column(const indexed_text::index_type* begin, const indexed_text::index_type* end,
+                                    const indexed_text::index_type* key, size_t key_size,
+                                    std::wstring_view column_key, indexed_text::index_type* out) {
+    using alphabet = polyalphabetic::symbols_type;
+    constexpr auto space = indexed_text::index_type(alphabet::index_of(L' '));
+    auto ciphered = polyalphabetic::cipher_worker<alphabet>::encrypt_view(begin, end, key, key_size);
+    column_transposition::encrypt_view(ciphered, column_key, out, space);
+    return column_transposition::encrypted_size(ciphered.size(), column_key.size());
+}
+
+}
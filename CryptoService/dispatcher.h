@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+#include "protocol.h"
+#include "utf8.h"
+#include "indexed_text.h"
+#include "chains.h"
+#include "CryptoCaesarCipher/caesar.h"
+#include "CryptoDirectSubstitution/direct_substitution.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+#include "CryptoMatrixSubstitution/matrix_substitution.h"
+#include "CryptoBlockTransposition/block_transposition.h"
+#include "CryptoColumnTransposition/column_transposition.h"
+#include "CryptoZorgeCypher/checkerboard.h"
+#include "CryptoZorgeCypher/formatter.h"
+
+/**
+ * Per worker thread state kept for the lifetime of the thread: the Zorge encryptor and formatter
+ * and the buffers requests are decoded and ciphered into, as wide symbols or as alphabet indices.
+ * The buffers only grow, so in steady state a request allocates nothing but its response payload.
+ */
+struct worker_state {
+    zorge::encryptor checkerboard;
+    formatter zorge_formatter{new to_upper, new remove_illegal_symbols(zorge::symbol_set), new letter_before_number,
+                              new number_before_letter};
+    std::wstring input;
+    std::wstring key;
+    std::wstring result;
+    //index form of the same, for the ciphers that run on indexed_text
+    std::vector<indexed_text::index_type> input_indices;
+    std::vector<indexed_text::index_type> key_indices;
+    std::vector<indexed_text::index_type> result_indices;
+};
+
+//resizes without giving capacity back, returns the start of the buffer
+template<typename String>
+typename String::value_type* reserve_buffer(String& buffer, size_t size) {
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+    return buffer.data();
+}
+
+inline std::wstring_view decode_into(std::string_view utf8, std::wstring& buffer) {
+    wchar_t* out = reserve_buffer(buffer, utf8::max_decoded(utf8.size()));
+    return {out, utf8::decode(utf8.data(), utf8.data() + utf8.size(), out)};
+}
+
+inline std::string encode_utf8(std::wstring_view text) {
+    INSTRUMENT_STAGE("service.utf8_encode", text.size() * sizeof(wchar_t));
+    std::string result(utf8::max_encoded(text.size()), '\0');
+    result.resize(utf8::encode(text.data(), text.data() + text.size(), &result[0]));
+    return result;
+}
+
+//decodes and validates UTF-8 into alphabet indices, returns the number of indices
+template<typename Alphabet>
+size_t decode_indices(std::string_view utf8, std::vector<indexed_text::index_type>& buffer) {
+    INSTRUMENT_STAGE("service.utf8_decode", utf8.size());
+    return indexed_text::decode<Alphabet>(utf8.data(), utf8.data() + utf8.size(),
+                                          reserve_buffer(buffer, utf8::max_decoded(utf8.size())));
+}
+
+template<typename Alphabet>
+std::string encode_indices(const indexed_text::index_type* indices, size_t length) {
+    INSTRUMENT_STAGE("service.utf8_encode", length);
+    std::string result(utf8::max_encoded(length), '\0');
+    result.resize(indexed_text::encode<Alphabet>(indices, indices + length, &result[0]));
+    return result;
+}
+
+//the keys of a chained cipher, first stage first; both views point into key
+inline std::pair<std::string_view, std::string_view> split_keys(const std::string& key) {
+    size_t separator = key.find('\n');
+    if (separator == std::string::npos) {
+        throw std::runtime_error("Chained ciphers need two keys");
+    }
+    if (separator == 0 || separator + 1 == key.size()) {
+        throw std::runtime_error("No key provided");
+    }
+    return {std::string_view(key).substr(0, separator), std::string_view(key).substr(separator + 1)};
+}
+
+/**
+ * Runs one request through the exercise kernels and returns the UTF-8 result.
+ * Caesar, polyalphabetic and direct substitution encryption validate their whole input against
+ * their alphabet, so they decode it straight into one byte alphabet indices and cipher those;
+ * the other ciphers pass symbols outside their alphabet through and work on wide symbols.
+ * Chained ciphers run fused, see chains.h.
+ * The interactive length limits of the exercises do not apply here.
+ * Throws for unknown ciphers, unsupported operations and illegal input.
+ */
+inline std::string dispatch(const request& req) {
+    thread_local worker_state state;
+
+    bool encrypt = req.operation == caesar::Encrypt;
+    if (!encrypt && req.operation != caesar::Decrypt) {
+        throw std::runtime_error("Illegal operation");
+    }
+    auto encrypt_only = [&]() {
+        if (!encrypt) {
+            throw std::runtime_error("Operation not supported");
+        }
+    };
+    auto require_key = [&]() {
+        if (req.key.empty()) {
+            throw std::runtime_error("No key provided");
+        }
+    };
+
+    switch (req.cipher) {
+        case CAESAR: {
+            using alphabet = caesar::symbols_type;
+            size_t length = decode_indices<alphabet>(req.payload, state.input_indices);
+            auto* in = state.input_indices.data();
+            auto* out = reserve_buffer(state.result_indices, length);
+            caesar::cipher_into<alphabet>(in, in + length, out, encrypt ? caesar::Encrypt : caesar::Decrypt);
+            return encode_indices<alphabet>(out, length);
+        }
+        case DIRECT_SUBSTITUTION:
+            if (encrypt) {
+                size_t length = decode_indices<direct_substitution::symbols_type>(req.payload, state.input_indices);
+                auto* in = state.input_indices.data();
+                std::string codes(length * direct_substitution::max_code_chars, '\0');
+                codes.resize(direct_substitution::write_codes(in, in + length, &codes[0]));
+                return codes;
+            } else {
+                wchar_t* out = reserve_buffer(state.result, req.payload.size());
+                direct_substitution::decryptor decode(direct_substitution::number_to_symbol, SIZE_MAX);
+                size_t length = decode(req.payload.data(), req.payload.data() + req.payload.size(), out);
+                return encode_utf8(std::wstring_view(out, length));
+            }
+        case POLYALPHABETIC: {
+            using alphabet = polyalphabetic::symbols_type;
+            require_key();
+            size_t key_length = decode_indices<alphabet>(req.key, state.key_indices);
+            size_t length = decode_indices<alphabet>(req.payload, state.input_indices);
+            auto* in = state.input_indices.data();
+            auto* out = reserve_buffer(state.result_indices, length);
+            polyalphabetic::cipher_into<alphabet>(in, in + length,
+                                                  encrypt ? polyalphabetic::Encrypt : polyalphabetic::Decrypt,
+                                                  state.key_indices.data(), key_length, out);
+            return encode_indices<alphabet>(out, length);
+        }
+        case ZORGE: {
+            encrypt_only();
+            std::string formatted = state.zorge_formatter.format_text(req.payload);
+            std::string codes(formatted.size() * zorge::max_code_chars, '\0');
+            codes.resize(zorge::encryptor::encrypt_into(formatted.data(), formatted.data() + formatted.size(),
+                                                        state.checkerboard.cached_checkerboard(req.key), &codes[0]));
+            return codes;
+        }
+        case ZORGE_BLOCK: {
+            encrypt_only();
+            auto keys = split_keys(req.key);
+            std::wstring_view block_key = decode_into(keys.second, state.key);
+            std::string formatted = state.zorge_formatter.format_text(req.payload);
+            std::string codes(chains::zorge_block_size(formatted.size(), block_key.size()), '\0');
+            codes.resize(chains::zorge_block(formatted.data(), formatted.data() + formatted.size(),
+                                             state.checkerboard.cached_checkerboard(std::string(keys.first)),
+                                             block_key, &codes[0]));
+            return codes;
+        }
+        case POLYALPHABETIC_COLUMN: {
+            using alphabet = polyalphabetic::symbols_type;
+            encrypt_only();
+            auto keys = split_keys(req.key);
+            size_t key_length = decode_indices<alphabet>(keys.first, state.key_indices);
+            std::wstring_view column_key = decode_into(keys.second, state.key);
+            size_t length = decode_indices<alphabet>(req.payload, state.input_indices);
+            auto* in = state.input_indices.data();
+            auto* out = reserve_buffer(state.result_indices,
+                                       chains::polyalphabetic_column_size(length, key_length, column_key.size()));
+            length = chains::polyalphabetic_column(in, in + length, state.key_indices.data(), key_length,
+                                                   column_key, out);
+            return encode_indices<alphabet>(out, length);
+        }
+        default:
+            break;
+    }
+
+    std::wstring_view input;
+    std::wstring_view key;
+    {
+        INSTRUMENT_STAGE("service.utf8_decode", req.payload.size() + req.key.size());
+        input = decode_into(req.payload, state.input);
+        key = decode_into(req.key, state.key);
+    }
+    const wchar_t* begin = input.data();
+    const wchar_t* end = input.data() + input.size();
+    wchar_t* out = reserve_buffer(state.result, input.size());
+    size_t length = input.size();
+    switch (req.cipher) {
+        case MATRIX_SUBSTITUTION:
+            encrypt_only();
+            require_key();
+            matrix_substitution::encrypt_into(begin, end, key, out);
+            break;
+        case BLOCK_TRANSPOSITION:
+            encrypt_only();
+            require_key();
+            length = block_transposition::encrypted_size(input.size(), key.size());
+            out = reserve_buffer(state.result, length);
+            block_transposition::encrypt_into(begin, end, key, out);
+            break;
+        case COLUMN_TRANSPOSITION:
+            encrypt_only();
+            require_key();
+            length = column_transposition::encrypted_size(input.size(), key.size());
+            out = reserve_buffer(state.result, length);
+            column_transposition::encrypt_into(begin, end, key, out);
+            break;
+        default:
+            throw std::runtime_error("Unknown cipher");
+    }
+    return encode_utf8(std::wstring_view(out, length));
+}
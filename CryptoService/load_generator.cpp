@@ -0,0 +1,244 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <codecvt>
+#include <locale>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "protocol.h"
+#include "corpus.h"
+#include "CryptoCaesarCipher/caesar.h"
+#include "CryptoDirectSubstitution/direct_substitution.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+#include "CryptoMatrixSubstitution/matrix_substitution.h"
+#include "CryptoBlockTransposition/block_transposition.h"
+#include "CryptoColumnTransposition/column_transposition.h"
+#include "CryptoZorgeCypher/checkerboard.h"
+
+using clock_type = std::chrono::steady_clock;
+
+struct cipher_profile {
+    std::string name;
+    uint8_t id;
+    std::wstring alphabet;
+    std::string key;
+};
+
+const std::vector<cipher_profile>& profiles() {
+    static const std::wstring zorge_alphabet =
+            std::wstring(zorge::symbol_set, zorge::symbol_set + zorge::symbols_type::size) + L"0123456789";
+    static const std::vector<cipher_profile> profiles = {
+            {"caesar", CAESAR, caesar::all_symbols, ""},
+            {"direct_substitution", DIRECT_SUBSTITUTION, direct_substitution::allowed_symbols, ""},
+            {"polyalphabetic", POLYALPHABETIC, polyalphabetic::allowed_symbols, "ТАЙНА2024"},
+            {"matrix_substitution", MATRIX_SUBSTITUTION, matrix_substitution::symbols, "ТАЙНА"},
+            {"block_transposition", BLOCK_TRANSPOSITION, block_transposition::symbols, "ШИФРОВКА"},
+            {"column_transposition", COLUMN_TRANSPOSITION, column_transposition::symbols, "ШИФРОВКА"},
+            {"zorge", ZORGE, zorge_alphabet, "SOMBRE"},
+            {"zorge_block", ZORGE_BLOCK, zorge_alphabet, "SOMBRE\nШИФРОВКА"},
+            {"polyalphabetic_column", POLYALPHABETIC_COLUMN, polyalphabetic::allowed_symbols, "ТАЙНА2024\nШИФРОВКА"},
+    };
+    return profiles;
+}
+
+int connect_to(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long");
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw std::runtime_error(std::string("Cannot connect: ") + strerror(errno));
+    }
+    return fd;
+}
+
+/**
+ * One connection: a sender keeps up to `pipeline` requests in flight, a receiver matches responses
+ * to their send time by request id.
+ */
+struct connection_run {
+    std::vector<double> latencies_ns;
+    size_t errors = 0;
+
+    void run(const std::string& socket_path, const std::string& frame_template, size_t requests, size_t pipeline) {
+        int fd = connect_to(socket_path);
+        std::vector<clock_type::time_point> sent(requests);
+        latencies_ns.reserve(requests);
+
+        std::mutex mutex;
+        std::condition_variable window;
+        size_t in_flight = 0;
+        std::string failure;
+
+        std::thread receiver([&]() {
+            std::string body;
+            try {
+                for (size_t received = 0; received < requests; ++received) {
+                    if (!read_frame(fd, body)) {
+                        throw std::runtime_error("Service closed the connection");
+                    }
+                    response res = decode_response(body);
+                    if (res.id >= requests) {
+                        throw std::runtime_error("Unknown request id in response");
+                    }
+                    latencies_ns.push_back(std::chrono::duration<double, std::nano>(clock_type::now() - sent[res.id]).count());
+                    if (res.status != STATUS_OK) {
+                        ++errors;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        --in_flight;
+                    }
+                    window.notify_one();
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failure = e.what();
+                window.notify_one();
+            }
+        });
+
+        std::string frame = frame_template;
+        for (size_t id = 0; id < requests; ++id) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                window.wait(lock, [&] { return in_flight < pipeline || !failure.empty(); });
+                if (!failure.empty()) {
+                    break;
+                }
+                ++in_flight;
+            }
+            //patch the request id in place, the rest of the frame is the same for every request
+            for (int i = 0; i < 4; ++i) {
+                frame[4 + i] = char(id >> (8 * i));
+            }
+            sent[id] = clock_type::now();
+            try {
+                write_full(fd, frame);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failure = e.what();
+                //unblocks the receiver
+                shutdown(fd, SHUT_RDWR);
+                break;
+            }
+        }
+        receiver.join();
+        close(fd);
+        if (!failure.empty()) {
+            throw std::runtime_error(failure);
+        }
+    }
+};
+
+void print_usage() {
+    std::cerr << "Usage: CryptoServiceLoad --socket path [--cipher caesar] [--operation 1|2] [--size symbols]\n"
+                 "                         [--requests count] [--connections count] [--pipeline depth]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string socket_path;
+    std::string cipher = "caesar";
+    uint8_t operation = caesar::Encrypt;
+    size_t size = 256;
+    size_t requests = 100000;
+    size_t connections = 4;
+    size_t pipeline = 64;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--socket") {
+            socket_path = value;
+        } else if (arg == "--cipher") {
+            cipher = value;
+        } else if (arg == "--operation") {
+            operation = std::stoi(value);
+        } else if (arg == "--size") {
+            size = std::stoul(value);
+        } else if (arg == "--requests") {
+            requests = std::stoul(value);
+        } else if (arg == "--connections") {
+            connections = std::stoul(value);
+        } else if (arg == "--pipeline") {
+            pipeline = std::stoul(value);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    auto profile = std::find_if(profiles().begin(), profiles().end(), [&](auto& p) { return p.name == cipher; });
+    if (socket_path.empty() || profile == profiles().end() || connections == 0 || pipeline == 0) {
+        print_usage();
+        return 2;
+    }
+
+    std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
+    request req;
+    req.cipher = profile->id;
+    req.operation = operation;
+    req.key = profile->key;
+    req.payload = converter.to_bytes(corpus_generator(0x5eed).generate(profile->alphabet.c_str(), size));
+    std::string frame = encode(req);
+
+    std::vector<connection_run> runs(connections);
+    std::vector<std::string> failures(connections);
+    std::vector<std::thread> threads;
+    size_t per_connection = requests / connections;
+
+    auto start = clock_type::now();
+    try {
+        for (size_t i = 0; i < connections; ++i) {
+            threads.emplace_back([&, i]() {
+                try {
+                    runs[i].run(socket_path, frame, per_connection, pipeline);
+                } catch (const std::exception& e) {
+                    failures[i] = e.what();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (auto& failure : failures) {
+            if (!failure.empty()) {
+                throw std::runtime_error(failure);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    std::vector<double> latencies;
+    size_t errors = 0;
+    for (auto& run : runs) {
+        latencies.insert(latencies.end(), run.latencies_ns.begin(), run.latencies_ns.end());
+        errors += run.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, size_t(latencies.size() * p))];
+    };
+
+    std::cout << "{\"cipher\":\"" << cipher << "\",\"requests\":" << latencies.size() << ",\"errors\":" << errors
+              << ",\"seconds\":" << seconds << ",\"requests_per_s\":" << latencies.size() / seconds
+              << ",\"p50_ns\":" << percentile(0.5) << ",\"p99_ns\":" << percentile(0.99)
+              << ",\"p999_ns\":" << percentile(0.999) << "}" << std::endl;
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstring>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "thread_pool.h"
+#include "protocol.h"
+#include "dispatcher.h"
+
+//one client stream; the descriptors are closed when the reader and every in-flight request are done with it
+class connection {
+    const int in_fd;
+    const int out_fd;
+    const bool owns_fds;
+    std::mutex write_mutex;
+
+public:
+    connection(int in_fd, int out_fd, bool owns_fds) : in_fd(in_fd), out_fd(out_fd), owns_fds(owns_fds) {}
+
+    ~connection() {
+        if (owns_fds) {
+            close(in_fd);
+            if (out_fd != in_fd) {
+                close(out_fd);
+            }
+        }
+    }
+
+    [[nodiscard]] int input() const {
+        return in_fd;
+    }
+
+    void send(const response& res) {
+        INSTRUMENT_STAGE("service.output", res.payload.size());
+        std::string frame = encode(res);
+        std::lock_guard<std::mutex> lock(write_mutex);
+        write_full(out_fd, frame);
+    }
+};
+
+void handle(const std::shared_ptr<connection>& conn, const request& req) {
+    response res;
+    res.id = req.id;
+    try {
+        res.payload = dispatch(req);
+    } catch (const std::exception& e) {
+        res.status = STATUS_ERROR;
+        res.payload = e.what();
+    }
+    try {
+        conn->send(res);
+    } catch (const std::exception& e) {
+        //the client went away, nothing left to do with the result
+    }
+}
+
+//reads requests until the stream ends and hands them to the pool; returns without waiting for them
+void serve(const std::shared_ptr<connection>& conn, thread_pool& pool) {
+    std::string body;
+    try {
+        while (read_frame(conn->input(), body)) {
+            request req = decode_request(body);
+            pool.submit([conn, req = std::move(req)]() { handle(conn, req); });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Dropping connection: " << e.what() << std::endl;
+    }
+}
+
+int listen_on(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long");
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    unlink(path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        throw std::runtime_error(std::string("Cannot listen on socket: ") + strerror(errno));
+    }
+    return fd;
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoService [--socket path] [--threads count] [--cache-stats]\n"
+                 "Without --socket requests are read from stdin and responses written to stdout.\n"
+                 "--cache-stats writes the key cache statistics to stderr on SIGUSR2 and at the end of stdin."
+              << std::endl;
+}
+
+//called before any other thread starts, so they all inherit the blocked signal and only the reporter receives it
+void report_cache_stats_on_signal() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::thread([signals]() {
+        int signal;
+        while (sigwait(&signals, &signal) == 0) {
+            key_caches::registry::instance().report(std::cerr);
+        }
+    }).detach();
+}
+
+int main(int argc, char* argv[]) {
+    std::string socket_path;
+    size_t threads = std::thread::hardware_concurrency();
+    bool cache_stats = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--cache-stats") {
+            cache_stats = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        if (arg == "--socket") {
+            socket_path = argv[++i];
+        } else if (arg == "--threads") {
+            threads = std::stoul(argv[++i]);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    //a client closing its end must not kill the service
+    signal(SIGPIPE, SIG_IGN);
+    if (cache_stats) {
+        report_cache_stats_on_signal();
+    }
+
+    if (socket_path.empty()) {
+        {
+            //destroyed before the report, so every request has been handled
+            thread_pool pool(threads);
+            serve(std::make_shared<connection>(STDIN_FILENO, STDOUT_FILENO, false), pool);
+        }
+        if (cache_stats) {
+            key_caches::registry::instance().report(std::cerr);
+        }
+        return 0;
+    }
+
+    thread_pool pool(threads);
+
+    try {
+        int listen_fd = listen_on(socket_path);
+        std::cerr << "Listening on " << socket_path << " with " << pool.size() << " workers" << std::endl;
+        while (true) {
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Accept failed: ") + strerror(errno));
+            }
+            std::thread(serve, std::make_shared<connection>(client_fd, client_fd, true), std::ref(pool)).detach();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
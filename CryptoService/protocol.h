@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+/**
+ * Length-prefixed frames, all integers little-endian.
+ *
+ * request:  [length: 4][id: 4][cipher: 1][operation: 1][key length: 2][key: UTF-8][payload: UTF-8]
+ * response: [length: 4][id: 4][status: 1][payload: UTF-8 result or error message]
+ *
+ * length counts the bytes after the length field itself. A client may send any number of requests
+ * without waiting; responses carry the request id and can arrive in a different order.
+ * The chained ciphers take the keys of both stages separated by a line break.
+ */
+enum cipher_id : uint8_t {
+    CAESAR = 1,
+    DIRECT_SUBSTITUTION,
+    POLYALPHABETIC,
+    MATRIX_SUBSTITUTION,
+    BLOCK_TRANSPOSITION,
+    COLUMN_TRANSPOSITION,
+    ZORGE,
+    //Zorge formatting and checkerboard, then block transposition
+    ZORGE_BLOCK,
+    //polyalphabetic with padding, then column transposition
+    POLYALPHABETIC_COLUMN
+};
+
+//cipher id by its lower case name, 0 for an unknown name
+inline uint8_t cipher_by_name(const std::string& name) {
+    static const char* const names[] = {"caesar", "direct_substitution", "polyalphabetic", "matrix_substitution",
+                                        "block_transposition", "column_transposition", "zorge", "zorge_block",
+                                        "polyalphabetic_column"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (name == names[i]) {
+            return uint8_t(CAESAR + i);
+        }
+    }
+    return 0;
+}
+
+enum response_status : uint8_t { STATUS_OK = 0, STATUS_ERROR };
+
+constexpr const uint32_t MAX_FRAME_LENGTH = 64 * 1024 * 1024;
+constexpr const size_t REQUEST_HEADER_SIZE = 8;
+constexpr const size_t RESPONSE_HEADER_SIZE = 5;
+
+struct request {
+    uint32_t id = 0;
+    uint8_t cipher = 0;
+    uint8_t operation = 0;
+    std::string key;
+    std::string payload;
+};
+
+struct response {
+    uint32_t id = 0;
+    uint8_t status = STATUS_OK;
+    std::string payload;
+};
+
+inline void put_u32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(char(value >> (8 * i)));
+    }
+}
+
+inline void put_u16(std::string& out, uint16_t value) {
+    out.push_back(char(value));
+    out.push_back(char(value >> 8));
+}
+
+inline uint32_t get_u32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= uint32_t(uint8_t(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+inline uint16_t get_u16(const char* in) {
+    return uint16_t(uint8_t(in[0]) | (uint8_t(in[1]) << 8));
+}
+
+//throws for keys longer than their 16 bit length field
+inline std::string encode(const request& req) {
+    if (req.key.size() > UINT16_MAX) {
+        throw std::runtime_error("Field too long");
+    }
+    std::string frame;
+    frame.reserve(4 + REQUEST_HEADER_SIZE + req.key.size() + req.payload.size());
+    put_u32(frame, REQUEST_HEADER_SIZE + req.key.size() + req.payload.size());
+    put_u32(frame, req.id);
+    frame.push_back(char(req.cipher));
+    frame.push_back(char(req.operation));
+    put_u16(frame, uint16_t(req.key.size()));
+    frame += req.key;
+    frame += req.payload;
+    return frame;
+}
+
+inline std::string encode(const response& res) {
+    std::string frame;
+    frame.reserve(4 + RESPONSE_HEADER_SIZE + res.payload.size());
+    put_u32(frame, RESPONSE_HEADER_SIZE + res.payload.size());
+    put_u32(frame, res.id);
+    frame.push_back(char(res.status));
+    frame += res.payload;
+    return frame;
+}
+
+//returns false on a clean end of stream before the first byte
+inline bool read_full(int fd, char* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = ::read(fd, buffer + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == 0 && done == 0) {
+                return false;
+            }
+            throw std::runtime_error("Truncated frame");
+        }
+        done += n;
+    }
+    return true;
+}
+
+inline void write_full(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("Connection closed");
+        }
+        done += n;
+    }
+}
+
+//reads the body of the next frame, returns false on a clean end of stream
+inline bool read_frame(int fd, std::string& body) {
+    char length[4];
+    if (!read_full(fd, length, sizeof(length))) {
+        return false;
+    }
+    uint32_t size = get_u32(length);
+    if (size > MAX_FRAME_LENGTH) {
+        throw std::runtime_error("Illegal frame length");
+    }
+    body.resize(size);
+    if (size != 0 && !read_full(fd, &body[0], size)) {
+        throw std::runtime_error("Truncated frame");
+    }
+    return true;
+}
+
+inline request decode_request(const std::string& body) {
+    if (body.size() < REQUEST_HEADER_SIZE) {
+        throw std::runtime_error("Illegal frame length");
+    }
+    request req;
+    req.id = get_u32(body.data());
+    req.cipher = uint8_t(body[4]);
+    req.operation = uint8_t(body[5]);
+    size_t key_length = get_u16(body.data() + 6);
+    if (REQUEST_HEADER_SIZE + key_length > body.size()) {
+        throw std::runtime_error("Illegal key length");
+    }
+    req.key = body.substr(REQUEST_HEADER_SIZE, key_length);
+    req.payload = body.substr(REQUEST_HEADER_SIZE + key_length);
+    return req;
+}
+
+inline response decode_response(const std::string& body) {
+    if (body.size() < RESPONSE_HEADER_SIZE) {
+        throw std::runtime_error("Illegal frame length");
+    }
+    response res;
+    res.id = get_u32(body.data());
+    res.status = uint8_t(body[4]);
+    res.payload = body.substr(RESPONSE_HEADER_SIZE);
+    return res;
+}
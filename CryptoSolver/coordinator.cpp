@@ -0,0 +1,456 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <optional>
+#include <functional>
+#include <chrono>
+#include <csignal>
+#include <poll.h>
+#include "alphabet.h"
+#include "utf8.h"
+#include "indexed_text.h"
+#include "keyspace.h"
+#include "shard_protocol.h"
+#include "solver_io.h"
+
+/**
+ * CryptoKeySearch: splits a key search into shards of consecutive ranks and hands them to worker processes
+ * (CryptoKeySearchWorker) connecting over a Unix domain socket or TCP, one shard per worker at a time.
+ * Shards are cut lazily in rank order, so the most likely keys (shorter keys, earlier words, lower restarts)
+ * are searched first. A worker that disconnects, or holds a shard longer than --shard-timeout, is dropped
+ * and its shard goes back to the front of the queue. Results are merged as they arrive.
+ */
+
+using clock_type = std::chrono::steady_clock;
+
+struct options {
+    std::string address;
+    std::string search = "substitution";
+    std::string alphabet = "cyrillic";
+    std::string input = "text";
+    std::string dictionary_path;
+    uint64_t restarts = 64;
+    uint64_t seed = 0;
+    size_t min_length = 1;
+    size_t max_length = 1;
+    size_t prefix = 200;
+    uint64_t shard_size = 0;
+    size_t top = 5;
+    double shard_timeout = 0;
+};
+
+struct worker_connection {
+    size_t number = 0;
+    size_t threads = 0;
+    std::optional<keyspace::shard> shard;
+    clock_type::time_point assigned;
+    //received bytes of an incomplete frame
+    std::string pending;
+};
+
+class coordinator {
+    const keyspace::job& task;
+    const uint64_t keys;
+    const uint64_t shard_size;
+    const uint64_t total_shards;
+    const std::vector<std::string>& words;
+    const double shard_timeout;
+
+    uint64_t next_rank = 0;
+    uint64_t next_id = 0;
+    std::deque<keyspace::shard> requeued;
+    uint64_t completed = 0;
+    size_t reassigned = 0;
+    size_t workers_seen = 0;
+    std::map<int, worker_connection> workers;
+    keyspace::top_candidates best;
+    //reports progress on stderr through the key of a candidate
+    std::function<std::string(const keyspace::candidate&)> describe;
+
+    std::optional<keyspace::shard> take() {
+        if (!requeued.empty()) {
+            keyspace::shard part = std::move(requeued.front());
+            requeued.pop_front();
+            return part;
+        }
+        if (next_rank == keys) {
+            return std::nullopt;
+        }
+        keyspace::shard part;
+        part.id = next_id++;
+        part.begin = next_rank;
+        part.end = next_rank + std::min(shard_size, keys - next_rank);
+        if (task.kind == keyspace::POLYALPHABETIC_DICTIONARY) {
+            part.words.assign(words.begin() + part.begin, words.begin() + part.end);
+        }
+        next_rank = part.end;
+        return part;
+    }
+
+    void assign(int fd, worker_connection& worker) {
+        if (auto part = take()) {
+            worker.shard = std::move(part);
+            worker.assigned = clock_type::now();
+            shards::send_shard(fd, *worker.shard);
+        }
+    }
+
+    void drop(int fd, const std::string& reason) {
+        worker_connection& worker = workers[fd];
+        std::cerr << "Worker " << worker.number << " dropped: " << reason;
+        if (worker.shard) {
+            std::cerr << ", shard " << worker.shard->id << " requeued";
+            requeued.push_front(std::move(*worker.shard));
+            ++reassigned;
+        }
+        std::cerr << std::endl;
+        close(fd);
+        workers.erase(fd);
+    }
+
+    /**
+     * Reads what poll reported readable, one read that cannot block, and handles every frame completed by it.
+     * A worker stalling mid-frame leaves its bytes pending instead of stopping the loop, so it still times out.
+     */
+    void receive(int fd, worker_connection& worker) {
+        char buffer[1 << 16];
+        ssize_t received = ::read(fd, buffer, sizeof(buffer));
+        if (received < 0 && errno == EINTR) {
+            return;
+        }
+        if (received <= 0) {
+            throw std::runtime_error("disconnected");
+        }
+        worker.pending.append(buffer, size_t(received));
+        while (worker.pending.size() >= 4) {
+            uint32_t size = get_u32(worker.pending.data());
+            if (size > MAX_FRAME_LENGTH) {
+                throw std::runtime_error("Illegal frame length");
+            }
+            if (worker.pending.size() - 4 < size) {
+                return;
+            }
+            std::string body = worker.pending.substr(4, size);
+            worker.pending.erase(0, 4 + size_t(size));
+            handle(fd, worker, body);
+        }
+    }
+
+    void handle(int fd, worker_connection& worker, const std::string& body) {
+        shards::message_reader in(body);
+        if (in.type() == shards::HELLO && worker.threads == 0) {
+            worker.threads = std::max<size_t>(1, in.u32());
+            std::cerr << "Worker " << worker.number << " joined with " << worker.threads << " threads" << std::endl;
+            shards::send_job(fd, task);
+        } else if (in.type() == shards::RESULT && worker.shard) {
+            uint64_t id;
+            auto candidates = shards::read_result(in, id);
+            if (id != worker.shard->id) {
+                throw std::runtime_error("result for the wrong shard");
+            }
+            std::optional<double> previous;
+            if (!best.items().empty()) {
+                previous = best.items().front().score;
+            }
+            for (auto& c : candidates) {
+                best.add(std::move(c));
+            }
+            worker.shard.reset();
+            ++completed;
+            if (!best.items().empty() && previous != best.items().front().score) {
+                const auto& leader = best.items().front();
+                std::cerr << "[" << completed << "/" << total_shards << "] best " << leader.score << " at rank "
+                          << leader.rank << ": " << describe(leader) << std::endl;
+            }
+        } else {
+            throw std::runtime_error("unexpected message");
+        }
+        assign(fd, worker);
+    }
+
+    void check_timeouts() {
+        if (shard_timeout <= 0) {
+            return;
+        }
+        auto now = clock_type::now();
+        std::vector<int> late;
+        for (const auto& [fd, worker] : workers) {
+            if (worker.shard && std::chrono::duration<double>(now - worker.assigned).count() > shard_timeout) {
+                late.push_back(fd);
+            }
+        }
+        for (int fd : late) {
+            drop(fd, "shard timed out");
+        }
+    }
+
+    //idle workers get the shards given back by dropped ones
+    void assign_idle() {
+        for (auto& [fd, worker] : workers) {
+            if (requeued.empty()) {
+                return;
+            }
+            if (worker.threads != 0 && !worker.shard) {
+                try {
+                    assign(fd, worker);
+                } catch (const std::exception& e) {
+                    drop(fd, e.what());
+                    return;
+                }
+            }
+        }
+    }
+
+public:
+    coordinator(const keyspace::job& task, uint64_t keys, uint64_t shard_size, const std::vector<std::string>& words,
+                double shard_timeout, std::function<std::string(const keyspace::candidate&)> describe)
+        : task(task), keys(keys), shard_size(std::max<uint64_t>(shard_size, 1)),
+          total_shards((keys + this->shard_size - 1) / this->shard_size), words(words),
+          shard_timeout(shard_timeout), best(task.top), describe(std::move(describe)) {}
+
+    std::vector<keyspace::candidate> run(int listen_fd) {
+        while (completed < total_shards) {
+            std::vector<pollfd> polled{{listen_fd, POLLIN, 0}};
+            for (const auto& [fd, worker] : workers) {
+                polled.push_back({fd, POLLIN, 0});
+            }
+            if (poll(polled.data(), polled.size(), shard_timeout > 0 ? 1000 : -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Cannot poll: ") + strerror(errno));
+            }
+            for (size_t i = 1; i < polled.size(); ++i) {
+                if (polled[i].revents == 0) {
+                    continue;
+                }
+                int fd = polled[i].fd;
+                try {
+                    receive(fd, workers[fd]);
+                } catch (const std::exception& e) {
+                    drop(fd, e.what());
+                }
+            }
+            if (polled[0].revents & POLLIN) {
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd >= 0) {
+                    workers[fd].number = ++workers_seen;
+                }
+            }
+            check_timeouts();
+            assign_idle();
+        }
+        for (const auto& [fd, worker] : workers) {
+            close(fd);
+        }
+        workers.clear();
+        return best.items();
+    }
+
+    [[nodiscard]] size_t reassigned_shards() const {
+        return reassigned;
+    }
+
+    [[nodiscard]] size_t workers_joined() const {
+        return workers_seen;
+    }
+};
+
+std::string encode_symbols(const std::vector<uint8_t>& indices) {
+    std::string result(utf8::max_encoded(indices.size()), '\0');
+    result.resize(indexed_text::encode<keyspace::cipher_alphabet>(indices.data(), indices.data() + indices.size(),
+                                                                  &result[0]));
+    return result;
+}
+
+std::vector<std::string> read_words(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::vector<std::string> words;
+    std::string word;
+    while (std::getline(in, word)) {
+        if (!word.empty() && word.back() == '\r') {
+            word.pop_back();
+        }
+        words.push_back(word);
+    }
+    return words;
+}
+
+/**
+ * Prints the plaintext under the best key and then score, rank and key of every candidate. Substitution
+ * keys are the plaintext symbols of the ciphertext symbols in order of first appearance.
+ */
+template<typename Alphabet>
+int search(const options& config, const std::string& text) {
+    keyspace::job task;
+    task.alphabet = config.alphabet;
+    task.seed = config.seed;
+    task.min_length = uint16_t(config.min_length);
+    task.max_length = uint16_t(config.max_length);
+    task.top = uint32_t(config.top);
+
+    solver::ciphertext substituted;
+    std::vector<uint8_t> cipher;
+    std::vector<std::string> words;
+    uint64_t keys;
+    uint64_t shard_size = config.shard_size;
+    std::function<std::string(const keyspace::candidate&)> describe;
+    std::function<std::string(const keyspace::candidate&)> decrypt;
+
+    if (config.search == "substitution") {
+        task.kind = keyspace::SUBSTITUTION;
+        substituted = config.input == "text" ? solver::read_text(text) : solver::read_codes(text);
+        task.cipher = substituted.indices;
+        keys = config.restarts;
+        shard_size = shard_size != 0 ? shard_size : 4;
+        describe = [&](const keyspace::candidate& c) {
+            std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
+            std::wstring symbols;
+            for (size_t i = 0; i < substituted.symbols.size(); ++i) {
+                symbols += Alphabet::symbol_at(c.key[i]);
+            }
+            return converter.to_bytes(symbols);
+        };
+        decrypt = [&](const keyspace::candidate& c) {
+            std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
+            std::wstring plain;
+            for (auto index : substituted.indices) {
+                plain += Alphabet::symbol_at(c.key[index]);
+            }
+            return converter.to_bytes(plain);
+        };
+    } else {
+        std::string stripped;
+        for (char c : text) {
+            if (c != '\n' && c != '\r') {
+                stripped.push_back(c);
+            }
+        }
+        cipher.resize(utf8::max_decoded(stripped.size()));
+        const char* end = stripped.data() + stripped.size();
+        cipher.resize(indexed_text::decode<keyspace::cipher_alphabet>(stripped.data(), end, cipher.data()));
+        if (cipher.empty()) {
+            throw std::runtime_error("No ciphertext provided");
+        }
+        task.cipher.assign(cipher.begin(), cipher.begin() + std::min(cipher.size(), config.prefix));
+        if (!config.dictionary_path.empty()) {
+            task.kind = keyspace::POLYALPHABETIC_DICTIONARY;
+            words = read_words(config.dictionary_path);
+            keys = words.size();
+        } else {
+            task.kind = keyspace::POLYALPHABETIC_KEYS;
+            keys = keyspace::key_range(keyspace::cipher_alphabet::size, config.min_length, config.max_length).size();
+        }
+        shard_size = shard_size != 0 ? shard_size : 1 << 16;
+        describe = [](const keyspace::candidate& c) { return encode_symbols(c.key); };
+        decrypt = [&](const keyspace::candidate& c) {
+            std::vector<uint8_t> plain(cipher.size());
+            polyalphabetic::cipher_into<keyspace::cipher_alphabet>(cipher.data(), cipher.data() + cipher.size(),
+                                                                   polyalphabetic::Decrypt, c.key.data(),
+                                                                   c.key.size(), plain.data());
+            return encode_symbols(plain);
+        };
+    }
+    if (keys == 0) {
+        throw std::runtime_error("Empty keyspace");
+    }
+    //a job every worker would reject would have its shards requeued forever
+    keyspace::check_job<Alphabet>(task);
+
+    int listen_fd = shards::listen_on(config.address);
+    std::cerr << "Searching " << keys << " keys in shards of " << shard_size << " on " << config.address << std::endl;
+    auto start = clock_type::now();
+    coordinator run(task, keys, shard_size, words, config.shard_timeout, describe);
+    std::vector<keyspace::candidate> result = run.run(listen_fd);
+    double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    close(listen_fd);
+    if (!shards::is_tcp(config.address)) {
+        unlink(config.address.c_str());
+    }
+
+    if (!result.empty()) {
+        std::cout << decrypt(result.front()) << std::endl;
+    }
+    for (const auto& c : result) {
+        std::cout << c.score << '\t' << c.rank << '\t' << describe(c) << std::endl;
+    }
+    std::cerr << keys << " keys in " << seconds << " s (" << keys / seconds << " keys/s), " << run.workers_joined()
+              << " workers, " << run.reassigned_shards() << " shards reassigned" << std::endl;
+    return 0;
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoKeySearch --listen path|host:port [--search substitution|polyalphabetic]\n"
+                 "                       [--alphabet cyrillic|latin] [--top count] [--shard-size keys]\n"
+                 "                       [--shard-timeout seconds]\n"
+                 "  substitution:   [--input text|codes] [--restarts count] [--seed value]\n"
+                 "  polyalphabetic: [--key-lengths min-max | --dictionary words.txt] [--prefix symbols]\n"
+                 "Reads the ciphertext from stdin, hands shards of the keyspace to CryptoKeySearchWorker processes\n"
+                 "and prints the plaintext under the best key and the best candidates." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    options config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--listen") {
+            config.address = value;
+        } else if (arg == "--search") {
+            config.search = value;
+        } else if (arg == "--alphabet") {
+            config.alphabet = value;
+        } else if (arg == "--input") {
+            config.input = value;
+        } else if (arg == "--restarts") {
+            config.restarts = std::stoull(value);
+        } else if (arg == "--seed") {
+            config.seed = std::stoull(value);
+        } else if (arg == "--key-lengths") {
+            size_t dash = value.find('-');
+            config.min_length = std::stoul(value.substr(0, dash));
+            config.max_length = dash == std::string::npos ? config.min_length : std::stoul(value.substr(dash + 1));
+        } else if (arg == "--dictionary") {
+            config.dictionary_path = value;
+        } else if (arg == "--prefix") {
+            config.prefix = std::stoul(value);
+        } else if (arg == "--shard-size") {
+            config.shard_size = std::stoull(value);
+        } else if (arg == "--top") {
+            config.top = std::stoul(value);
+        } else if (arg == "--shard-timeout") {
+            config.shard_timeout = std::stod(value);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (config.address.empty() || (config.search != "substitution" && config.search != "polyalphabetic") ||
+        (config.alphabet != "cyrillic" && config.alphabet != "latin") ||
+        (config.input != "text" && config.input != "codes") || config.prefix < 4) {
+        print_usage();
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    try {
+        std::string text = solver::read_all(std::cin);
+        if (config.alphabet == "cyrillic") {
+            return search<alphabets::cyrillic_digits>(config, text);
+        }
+        return search<alphabets::latin>(config, text);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
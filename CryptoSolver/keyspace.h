@@ -0,0 +1,317 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "utf8.h"
+#include "ngram_table.h"
+#include "parallel_transform.h"
+#include "quadgram_model.h"
+#include "solver.h"
+#include "CryptoPolyalphabeticSubstitution/polyalphabetic.h"
+
+/**
+ * Key searches split into ranked shards for CryptoKeySearch. Every key of a search has a rank, and a shard
+ * is a range of ranks; a worker turns a shard into its best candidates, which the coordinator merges.
+ * Candidates are ordered by score, ties by rank, and the result does not depend on how the ranks were
+ * sharded or on the order the shards came back in.
+ */
+namespace keyspace {
+
+enum search_kind : uint8_t {
+    //restarts of the substitution hill climber, the rank is the restart number
+    SUBSTITUTION = 1,
+    //every polyalphabetic key of a range of lengths, shorter keys first
+    POLYALPHABETIC_KEYS,
+    //polyalphabetic keys from a word list, the rank is the word number
+    POLYALPHABETIC_DICTIONARY
+};
+
+using cipher_alphabet = polyalphabetic::symbols_type;
+
+//the longest exhaustive polyalphabetic keys, the ranks of longer ones overflow 64 bits
+constexpr const size_t max_key_length = 10;
+
+struct job {
+    search_kind kind = SUBSTITUTION;
+    //alphabet of the quadgram model, cyrillic or latin
+    std::string alphabet = "cyrillic";
+    //substitution restarts
+    uint64_t seed = 0;
+    //exhaustive polyalphabetic keys
+    uint16_t min_length = 1;
+    uint16_t max_length = 1;
+    //candidates kept per shard and in the result
+    uint32_t top = 5;
+    //substitution: ciphertext symbol numbers; polyalphabetic: cipher_alphabet indices of the scored prefix
+    std::vector<uint8_t> cipher;
+};
+
+struct shard {
+    uint64_t id = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    //dictionary searches: the words of ranks begin..end, UTF-8
+    std::vector<std::string> words;
+};
+
+struct candidate {
+    double score = 0;
+    uint64_t rank = 0;
+    //substitution: plaintext alphabet index per ciphertext symbol that occurs; polyalphabetic: key symbol indices
+    std::vector<uint8_t> key;
+};
+
+inline bool better(const candidate& a, const candidate& b) {
+    return a.score != b.score ? a.score > b.score : a.rank < b.rank;
+}
+
+//the limit best distinct keys added, best first; every key counts with its best rank
+class top_candidates {
+    size_t limit;
+    std::vector<candidate> best;
+
+public:
+    explicit top_candidates(size_t limit) : limit(std::max<size_t>(limit, 1)) {}
+
+    void add(double score, uint64_t rank, const std::vector<uint8_t>& key) {
+        //cheap rejection first, nearly every key of an exhaustive search ends here
+        if (best.size() == limit && !better({score, rank, {}}, best.back())) {
+            return;
+        }
+        add(candidate{score, rank, key});
+    }
+
+    void add(candidate next) {
+        if (best.size() == limit && !better(next, best.back())) {
+            return;
+        }
+        auto same = std::find_if(best.begin(), best.end(), [&](const candidate& c) { return c.key == next.key; });
+        if (same != best.end()) {
+            if (!better(next, *same)) {
+                return;
+            }
+            best.erase(same);
+        }
+        best.insert(std::upper_bound(best.begin(), best.end(), next, better), std::move(next));
+        if (best.size() > limit) {
+            best.pop_back();
+        }
+    }
+
+    [[nodiscard]] const std::vector<candidate>& items() const {
+        return best;
+    }
+};
+
+//keys of min_length..max_length symbols, shorter keys first, then by symbol with the first one most significant
+class key_range {
+    size_t symbols;
+    size_t min_length;
+    size_t max_length;
+
+    [[nodiscard]] uint64_t keys_of_length(size_t length) const {
+        return ngram_tables::entries(symbols, length);
+    }
+
+public:
+    key_range(size_t symbols, size_t min_length, size_t max_length)
+        : symbols(symbols), min_length(min_length), max_length(max_length) {
+        if (min_length == 0 || min_length > max_length || max_length > max_key_length) {
+            throw std::runtime_error("Key lengths must be within 1.." + std::to_string(max_key_length));
+        }
+    }
+
+    [[nodiscard]] uint64_t size() const {
+        uint64_t result = 0;
+        for (size_t length = min_length; length <= max_length; ++length) {
+            result += keys_of_length(length);
+        }
+        return result;
+    }
+
+    void unrank(uint64_t rank, std::vector<uint8_t>& key) const {
+        size_t length = min_length;
+        while (rank >= keys_of_length(length)) {
+            rank -= keys_of_length(length++);
+        }
+        key.resize(length);
+        for (size_t i = length; i-- > 0; rank /= symbols) {
+            key[i] = uint8_t(rank % symbols);
+        }
+    }
+
+    //the key of the next rank
+    void next(std::vector<uint8_t>& key) const {
+        for (size_t i = key.size(); i-- > 0;) {
+            if (++key[i] < symbols) {
+                return;
+            }
+            key[i] = 0;
+        }
+        key.assign(key.size() + 1, 0);
+    }
+};
+
+//key indices of a dictionary word, upper cased; nullopt if it has symbols outside the alphabet
+inline std::optional<std::vector<uint8_t>> word_key(const std::string& word) {
+    std::vector<uint8_t> key;
+    const char* it = word.data();
+    const char* end = it + word.size();
+    try {
+        while (it != end) {
+            int index = ngram_tables::symbol_index<cipher_alphabet>(utf8::decode_symbol(it, end));
+            if (index == -1) {
+                return std::nullopt;
+            }
+            key.push_back(uint8_t(index));
+        }
+    } catch (const std::range_error&) {
+        return std::nullopt;
+    }
+    if (key.empty()) {
+        return std::nullopt;
+    }
+    return key;
+}
+
+/**
+ * Scores polyalphabetic keys by the quadgrams of the ciphertext they decrypt it to. Plaintext symbols outside
+ * the model alphabet read as spaces and runs of them are kept, unlike in training text, so every key is scored
+ * over the same number of quadgrams and a key turning the text into symbols the model lacks scores low.
+ */
+template<typename Alphabet>
+class polyalphabetic_scorer {
+    static constexpr int space = Alphabet::index_of(' ');
+    static_assert(space != -1, "Symbols outside the model alphabet are scored as spaces");
+
+    const solver::quadgram_model<Alphabet>& model;
+    const std::vector<uint8_t>& cipher;
+    std::array<uint8_t, cipher_alphabet::size> to_model{};
+
+public:
+    polyalphabetic_scorer(const solver::quadgram_model<Alphabet>& model, const std::vector<uint8_t>& cipher)
+        : model(model), cipher(cipher) {
+        for (size_t i = 0; i < cipher_alphabet::size; ++i) {
+            int index = ngram_tables::symbol_index<Alphabet>(uint32_t(cipher_alphabet::symbol_at(i)));
+            to_model[i] = uint8_t(index == -1 ? space : index);
+        }
+    }
+
+    //plain is a scratch buffer kept by the caller
+    double score(const std::vector<uint8_t>& key, std::vector<uint8_t>& plain) const {
+        plain.resize(cipher.size());
+        polyalphabetic::cipher_into<cipher_alphabet>(cipher.data(), cipher.data() + cipher.size(),
+                                                     polyalphabetic::Decrypt, key.data(), key.size(), plain.data());
+        for (auto& symbol : plain) {
+            symbol = to_model[symbol];
+        }
+        double result = 0;
+        for (size_t i = 3; i < plain.size(); ++i) {
+            result += model.score(plain[i - 3], plain[i - 2], plain[i - 1], plain[i]);
+        }
+        return result;
+    }
+};
+
+//throws for a job no worker could run, so the coordinator rejects it before handing out any shard
+template<typename Alphabet>
+void check_job(const job& task) {
+    if (task.kind == SUBSTITUTION) {
+        solver::hill_climber<Alphabet>::check(task.cipher);
+    } else if (task.kind == POLYALPHABETIC_KEYS) {
+        key_range(cipher_alphabet::size, task.min_length, task.max_length);
+    } else if (task.kind != POLYALPHABETIC_DICTIONARY) {
+        throw std::runtime_error("Unknown search");
+    }
+    if (task.kind != SUBSTITUTION && task.cipher.empty()) {
+        throw std::runtime_error("No ciphertext provided");
+    }
+}
+
+//runs the shards of one job on up to threads threads (0 = all cores)
+template<typename Alphabet>
+class searcher {
+    const job& task;
+    const solver::quadgram_model<Alphabet>& model;
+    const size_t threads;
+    std::optional<solver::hill_climber<Alphabet>> climber;
+    std::optional<key_range> range;
+    //substitution: distinct ciphertext symbols
+    size_t symbols = 0;
+
+    /**
+     * Keys are cut to the plaintext symbols of the ciphertext symbols, which are numbered 0 .. symbols - 1 in
+     * order of first appearance. The rest of a climbed permutation is random and would make restarts that
+     * found the same decryption count as different keys.
+     */
+    void substitution(uint64_t begin, uint64_t end, top_candidates& best) const {
+        for (uint64_t restart = begin; restart < end; ++restart) {
+            solver::solution result = climber->climb_restart(restart, task.seed);
+            result.key.resize(symbols);
+            best.add(candidate{result.score, restart, std::move(result.key)});
+        }
+    }
+
+    void keys(uint64_t begin, uint64_t end, top_candidates& best) const {
+        polyalphabetic_scorer<Alphabet> scorer(model, task.cipher);
+        std::vector<uint8_t> key, plain;
+        range->unrank(begin, key);
+        for (uint64_t rank = begin; rank < end; ++rank, range->next(key)) {
+            best.add(scorer.score(key, plain), rank, key);
+        }
+    }
+
+    void words(const shard& part, uint64_t begin, uint64_t end, top_candidates& best) const {
+        polyalphabetic_scorer<Alphabet> scorer(model, task.cipher);
+        std::vector<uint8_t> plain;
+        for (uint64_t rank = begin; rank < end; ++rank) {
+            if (auto key = word_key(part.words[rank - part.begin])) {
+                best.add(scorer.score(*key, plain), rank, *key);
+            }
+        }
+    }
+
+public:
+    searcher(const job& task, const solver::quadgram_model<Alphabet>& model, size_t threads)
+        : task(task), model(model), threads(threads) {
+        check_job<Alphabet>(task);
+        if (task.kind == SUBSTITUTION) {
+            climber.emplace(model, task.cipher);
+            symbols = *std::max_element(task.cipher.begin(), task.cipher.end()) + 1;
+        } else if (task.kind == POLYALPHABETIC_KEYS) {
+            range.emplace(cipher_alphabet::size, task.min_length, task.max_length);
+        }
+    }
+
+    [[nodiscard]] std::vector<candidate> run(const shard& part) const {
+        if (part.end < part.begin || (range && part.end > range->size()) ||
+            (task.kind == POLYALPHABETIC_DICTIONARY && part.words.size() != part.end - part.begin)) {
+            throw std::runtime_error("Malformed shard");
+        }
+        std::vector<size_t> bounds = chunk_bounds(part.end - part.begin, threads, 1);
+        std::vector<top_candidates> partial(bounds.size() - 1, top_candidates(task.top));
+        for_each_chunk(bounds, [&](size_t chunk, size_t begin, size_t end) {
+            if (task.kind == SUBSTITUTION) {
+                substitution(part.begin + begin, part.begin + end, partial[chunk]);
+            } else if (task.kind == POLYALPHABETIC_KEYS) {
+                keys(part.begin + begin, part.begin + end, partial[chunk]);
+            } else {
+                words(part, part.begin + begin, part.begin + end, partial[chunk]);
+            }
+        });
+        top_candidates result(task.top);
+        for (auto& chunk : partial) {
+            for (const auto& c : chunk.items()) {
+                result.add(c);
+            }
+        }
+        return result.items();
+    }
+};
+
+}
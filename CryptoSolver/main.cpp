@@ -0,0 +1,100 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <codecvt>
+#include <locale>
+#include "alphabet.h"
+#include "quadgram_model.h"
+#include "solver.h"
+#include "solver_io.h"
+
+using namespace std;
+using solver::ciphertext;
+
+template<typename Alphabet>
+void solve(const solver::quadgram_model<Alphabet>& model, const ciphertext& cipher, size_t restarts, size_t threads,
+           uint64_t seed) {
+    wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
+
+    auto start = chrono::steady_clock::now();
+    solver::hill_climber<Alphabet> climber(model, cipher.indices);
+    solver::solution best = climber.solve(restarts, threads, seed);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    wstring plain;
+    for (auto index : climber.decrypt(best.key)) {
+        plain += Alphabet::symbol_at(index);
+    }
+    cout << converter.to_bytes(plain) << endl;
+    for (size_t i = 0; i < cipher.symbols.size(); ++i) {
+        cout << cipher.symbols[i] << " -> " << converter.to_bytes(Alphabet::symbol_at(best.key[i])) << endl;
+    }
+    cerr << "score " << best.score << " (restart " << best.restart << " of " << restarts << ") in " << seconds
+         << " s" << endl;
+}
+
+void print_usage() {
+    cerr << "Usage: CryptoSolver --corpus training.txt|--model table.bin [--input text|codes]\n"
+            "                    [--alphabet cyrillic|latin] [--restarts count] [--threads count] [--seed value]\n"
+            "Reads the ciphertext from stdin and prints the recovered plaintext and key." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string corpus_path;
+    string model_path;
+    string input = "text";
+    string alphabet = "cyrillic";
+    size_t restarts = 64;
+    size_t threads = 0;
+    uint64_t seed = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        string value = argv[++i];
+        if (arg == "--corpus") {
+            corpus_path = value;
+        } else if (arg == "--model") {
+            model_path = value;
+        } else if (arg == "--input") {
+            input = value;
+        } else if (arg == "--alphabet") {
+            alphabet = value;
+        } else if (arg == "--restarts") {
+            restarts = stoul(value);
+        } else if (arg == "--threads") {
+            threads = stoul(value);
+        } else if (arg == "--seed") {
+            seed = stoull(value);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (corpus_path.empty() == model_path.empty() || (input != "text" && input != "codes") ||
+        (alphabet != "cyrillic" && alphabet != "latin")) {
+        print_usage();
+        return 2;
+    }
+
+    try {
+        string text = solver::read_all(cin);
+        ciphertext cipher = input == "text" ? solver::read_text(text) : solver::read_codes(text);
+
+        if (alphabet == "cyrillic") {
+            using alphabet_type = alphabets::cyrillic_digits;
+            solve(solver::load_model<alphabet_type>(corpus_path, model_path), cipher, restarts, threads, seed);
+        } else {
+            using alphabet_type = alphabets::latin;
+            solve(solver::load_model<alphabet_type>(corpus_path, model_path), cipher, restarts, threads, seed);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
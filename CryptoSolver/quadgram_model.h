@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include "ngram_table.h"
+
+namespace solver {
+
+/**
+ * Quadgram log10 probabilities over a compile-time alphabet, in a flat size^4 table
+ * indexed by ((a * size + b) * size + c) * size + d.
+ * Quadgrams that never occur in the training text get the probability of 1/100 of a single occurrence.
+ * The table is trained from a text or mapped from a table file written by CryptoNgrams.
+ */
+template<typename Alphabet>
+class quadgram_model {
+public:
+    using char_type = typename Alphabet::char_type;
+    static constexpr size_t size = Alphabet::size;
+    static constexpr size_t table_size = size * size * size * size;
+
+private:
+    //owns the scores: the vector of a trained model or the mapping of a table file
+    std::shared_ptr<const void> storage;
+    const float* scores = nullptr;
+
+public:
+    /**
+     * Alphabet indices of text, upper cased. Symbols outside the alphabet become a single space
+     * if the alphabet has one and are dropped otherwise.
+     */
+    static std::vector<uint8_t> to_indices(const std::basic_string<char_type>& text) {
+        const int space = Alphabet::index_of(' ');
+        std::vector<uint8_t> result;
+        result.reserve(text.size());
+        for (auto symbol : text) {
+            int index = ngram_tables::symbol_index<Alphabet>(uint32_t(symbol));
+            if (index == -1) {
+                index = space;
+            }
+            if (index == -1 || (index == space && (result.empty() || result.back() == space))) {
+                continue;
+            }
+            result.push_back(uint8_t(index));
+        }
+        return result;
+    }
+
+    static quadgram_model train(const std::basic_string<char_type>& text) {
+        std::vector<uint8_t> indices = to_indices(text);
+        if (indices.size() < 4) {
+            throw std::runtime_error("Training text too short");
+        }
+        std::vector<uint32_t> counts(table_size);
+        size_t code = indices[0] * size * size + indices[1] * size + indices[2];
+        for (size_t i = 3; i < indices.size(); ++i) {
+            code = (code % (size * size * size)) * size + indices[i];
+            ++counts[code];
+        }
+
+        double total = double(indices.size() - 3);
+        auto table = std::make_shared<std::vector<float>>(table_size, float(std::log10(0.01 / total)));
+        for (size_t i = 0; i < table_size; ++i) {
+            if (counts[i] != 0) {
+                (*table)[i] = float(std::log10(counts[i] / total));
+            }
+        }
+        quadgram_model model;
+        model.scores = table->data();
+        model.storage = std::move(table);
+        return model;
+    }
+
+    //maps the quadgram scores of a table file built for this alphabet, see ngram_table.h
+    static quadgram_model load(const std::string& path) {
+        auto table = std::make_shared<ngram_tables::mapped_table>(path);
+        if (!table->template matches<Alphabet>()) {
+            throw std::runtime_error(path + " was built for another alphabet");
+        }
+        quadgram_model model;
+        model.scores = table->order(4);
+        model.storage = std::move(table);
+        return model;
+    }
+
+    [[nodiscard]] float score(size_t a, size_t b, size_t c, size_t d) const {
+        return scores[((a * size + b) * size + c) * size + d];
+    }
+};
+
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "CryptoService/protocol.h"
+#include "keyspace.h"
+
+/**
+ * Messages between CryptoKeySearch and its workers, in the length-prefixed frames of CryptoService/protocol.h.
+ * The first byte of a frame body is the message type, all integers are little-endian:
+ *
+ *  hello   worker -> coordinator  [threads: 4]
+ *  job     coordinator -> worker  [kind: 1][alphabet length: 2][alphabet][seed: 8][min length: 2][max length: 2]
+ *                                 [top: 4][ciphertext: rest]
+ *  shard   coordinator -> worker  [id: 8][begin: 8][end: 8][words: 4]([length: 2][UTF-8 word])...
+ *  result  worker -> coordinator  [shard id: 8][candidates: 4]([score: 8, IEEE double][rank: 8][length: 2][key])...
+ *
+ * A worker says hello, gets the job and then one shard at a time, answering each with its result.
+ * The coordinator closes the connection when the search is done.
+ */
+namespace shards {
+
+enum message_type : uint8_t { HELLO = 1, JOB, SHARD, RESULT };
+
+class message_writer {
+    std::string body;
+
+public:
+    explicit message_writer(message_type type) : body(1, char(type)) {}
+
+    void u8(uint8_t value) {
+        body.push_back(char(value));
+    }
+
+    void u16(uint16_t value) {
+        put_u16(body, value);
+    }
+
+    void u32(uint32_t value) {
+        put_u32(body, value);
+    }
+
+    void u64(uint64_t value) {
+        put_u32(body, uint32_t(value));
+        put_u32(body, uint32_t(value >> 32));
+    }
+
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        u64(bits);
+    }
+
+    //a string of up to 64 KiB behind its length
+    void text(const std::string& value) {
+        if (value.size() > UINT16_MAX) {
+            throw std::runtime_error("Field too long");
+        }
+        u16(uint16_t(value.size()));
+        body += value;
+    }
+
+    void rest(const std::string& value) {
+        body += value;
+    }
+
+    void send(int fd) const {
+        if (body.size() > MAX_FRAME_LENGTH) {
+            throw std::runtime_error("Message too long, use smaller shards");
+        }
+        std::string frame;
+        frame.reserve(4 + body.size());
+        put_u32(frame, uint32_t(body.size()));
+        frame += body;
+        write_full(fd, frame);
+    }
+};
+
+class message_reader {
+    const std::string& body;
+    size_t position = 1;
+
+    const char* take(size_t size) {
+        if (body.size() - position < size) {
+            throw std::runtime_error("Truncated message");
+        }
+        position += size;
+        return body.data() + position - size;
+    }
+
+public:
+    explicit message_reader(const std::string& body) : body(body) {
+        if (body.empty()) {
+            throw std::runtime_error("Empty message");
+        }
+    }
+
+    [[nodiscard]] message_type type() const {
+        return message_type(body[0]);
+    }
+
+    uint8_t u8() {
+        return uint8_t(*take(1));
+    }
+
+    uint16_t u16() {
+        return get_u16(take(2));
+    }
+
+    uint32_t u32() {
+        return get_u32(take(4));
+    }
+
+    uint64_t u64() {
+        const char* in = take(8);
+        return get_u32(in) | uint64_t(get_u32(in + 4)) << 32;
+    }
+
+    double f64() {
+        uint64_t bits = u64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string text() {
+        size_t size = u16();
+        return std::string(take(size), size);
+    }
+
+    std::string rest() {
+        size_t size = body.size() - position;
+        return std::string(take(size), size);
+    }
+};
+
+inline void send_hello(int fd, size_t threads) {
+    message_writer out(HELLO);
+    out.u32(uint32_t(threads));
+    out.send(fd);
+}
+
+inline void send_job(int fd, const keyspace::job& task) {
+    message_writer out(JOB);
+    out.u8(task.kind);
+    out.text(task.alphabet);
+    out.u64(task.seed);
+    out.u16(task.min_length);
+    out.u16(task.max_length);
+    out.u32(task.top);
+    out.rest(std::string(task.cipher.begin(), task.cipher.end()));
+    out.send(fd);
+}
+
+inline keyspace::job read_job(message_reader& in) {
+    keyspace::job task;
+    task.kind = keyspace::search_kind(in.u8());
+    task.alphabet = in.text();
+    task.seed = in.u64();
+    task.min_length = in.u16();
+    task.max_length = in.u16();
+    task.top = in.u32();
+    std::string cipher = in.rest();
+    task.cipher.assign(cipher.begin(), cipher.end());
+    return task;
+}
+
+inline void send_shard(int fd, const keyspace::shard& part) {
+    message_writer out(SHARD);
+    out.u64(part.id);
+    out.u64(part.begin);
+    out.u64(part.end);
+    out.u32(uint32_t(part.words.size()));
+    for (const auto& word : part.words) {
+        out.text(word);
+    }
+    out.send(fd);
+}
+
+inline keyspace::shard read_shard(message_reader& in) {
+    keyspace::shard part;
+    part.id = in.u64();
+    part.begin = in.u64();
+    part.end = in.u64();
+    size_t words = in.u32();
+    for (size_t i = 0; i < words; ++i) {
+        part.words.push_back(in.text());
+    }
+    return part;
+}
+
+inline void send_result(int fd, uint64_t shard_id, const std::vector<keyspace::candidate>& candidates) {
+    message_writer out(RESULT);
+    out.u64(shard_id);
+    out.u32(uint32_t(candidates.size()));
+    for (const auto& c : candidates) {
+        out.f64(c.score);
+        out.u64(c.rank);
+        out.text(std::string(c.key.begin(), c.key.end()));
+    }
+    out.send(fd);
+}
+
+inline std::vector<keyspace::candidate> read_result(message_reader& in, uint64_t& shard_id) {
+    shard_id = in.u64();
+    std::vector<keyspace::candidate> candidates(in.u32());
+    for (auto& c : candidates) {
+        c.score = in.f64();
+        c.rank = in.u64();
+        std::string key = in.text();
+        c.key.assign(key.begin(), key.end());
+    }
+    return candidates;
+}
+
+/**
+ * host:port is a TCP address, anything else the path of a Unix domain socket. Workers on other machines
+ * connect over TCP; several workers on one box can use either.
+ */
+inline bool is_tcp(const std::string& address) {
+    return address.find('/') == std::string::npos && address.rfind(':') != std::string::npos;
+}
+
+inline addrinfo* resolve(const std::string& address, bool passive) {
+    size_t colon = address.rfind(':');
+    std::string host = address.substr(0, colon);
+    std::string port = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (error != 0) {
+        throw std::runtime_error("Cannot resolve " + address + ": " + gai_strerror(error));
+    }
+    return result;
+}
+
+inline sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long");
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path.c_str());
+    return address;
+}
+
+inline int listen_on(const std::string& address) {
+    if (!is_tcp(address)) {
+        sockaddr_un local = unix_address(address);
+        unlink(address.c_str());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+            listen(fd, SOMAXCONN) != 0) {
+            throw std::runtime_error(std::string("Cannot listen on socket: ") + strerror(errno));
+        }
+        return fd;
+    }
+    addrinfo* info = resolve(address, true);
+    int fd = socket(info->ai_family, SOCK_STREAM, 0);
+    int on = 1;
+    bool bound = fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) == 0 &&
+                 bind(fd, info->ai_addr, info->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+    freeaddrinfo(info);
+    if (!bound) {
+        throw std::runtime_error("Cannot listen on " + address + ": " + strerror(errno));
+    }
+    return fd;
+}
+
+//-1 if nobody listens at the address yet
+inline int connect_to(const std::string& address) {
+    int fd;
+    bool connected;
+    if (!is_tcp(address)) {
+        sockaddr_un remote = unix_address(address);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        connected = fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) == 0;
+    } else {
+        addrinfo* info = resolve(address, false);
+        fd = socket(info->ai_family, SOCK_STREAM, 0);
+        connected = fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) == 0;
+        freeaddrinfo(info);
+        int on = 1;
+        if (connected) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        }
+    }
+    if (!connected) {
+        int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (error == ENOENT || error == ECONNREFUSED) {
+            return -1;
+        }
+        throw std::runtime_error("Cannot connect to " + address + ": " + strerror(error));
+    }
+    return fd;
+}
+
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "parallel_transform.h"
+#include "quadgram_model.h"
+
+namespace solver {
+
+struct solution {
+    //plaintext alphabet index for every ciphertext symbol
+    std::vector<uint8_t> key;
+    double score = 0;
+    size_t restart = 0;
+};
+
+/**
+ * Recovers a general substitution key by hill-climbing over swaps of the key, scored by quadgram
+ * log probabilities. Ciphertext symbols are given as indices 0..n-1, n at most the alphabet size;
+ * the key is kept as a full permutation of the alphabet, so symbols that do not occur in the
+ * ciphertext can still trade places with those that do.
+ * A swap only rescores the quadgrams touching the two swapped symbols.
+ */
+template<typename Alphabet>
+class hill_climber {
+    static constexpr size_t size = Alphabet::size;
+
+    const quadgram_model<Alphabet>& model;
+    const std::vector<uint8_t> cipher;
+    //ciphertext positions of every symbol
+    std::vector<std::vector<uint32_t>> occurrences;
+    //start positions of the quadgrams every symbol takes part in, sorted and unique
+    std::vector<std::vector<uint32_t>> quadgrams;
+
+    static uint64_t mix(uint64_t& state) {
+        //splitmix64
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    double score_at(const std::vector<uint8_t>& plain, uint32_t start) const {
+        return model.score(plain[start], plain[start + 1], plain[start + 2], plain[start + 3]);
+    }
+
+    //union of the quadgrams of two symbols, the ones containing both are scored once
+    template<typename Visit>
+    void for_each_quadgram(size_t a, size_t b, Visit visit) const {
+        const auto& first = quadgrams[a];
+        const auto& second = quadgrams[b];
+        size_t i = 0, j = 0;
+        while (i < first.size() || j < second.size()) {
+            if (j == second.size() || (i < first.size() && first[i] < second[j])) {
+                visit(first[i++]);
+            } else if (i == first.size() || second[j] < first[i]) {
+                visit(second[j++]);
+            } else {
+                visit(first[i]);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    void apply(std::vector<uint8_t>& plain, const std::vector<uint8_t>& key, size_t symbol) const {
+        for (auto position : occurrences[symbol]) {
+            plain[position] = key[symbol];
+        }
+    }
+
+public:
+    //throws for a ciphertext the climber cannot search, without a model
+    static void check(const std::vector<uint8_t>& ciphertext) {
+        if (ciphertext.size() < 4) {
+            throw std::runtime_error("Ciphertext too short");
+        }
+        if (*std::max_element(ciphertext.begin(), ciphertext.end()) >= size) {
+            throw std::runtime_error("More ciphertext symbols than alphabet symbols");
+        }
+    }
+
+    hill_climber(const quadgram_model<Alphabet>& model, std::vector<uint8_t> ciphertext)
+            : model(model), cipher(std::move(ciphertext)), occurrences(size), quadgrams(size) {
+        check(cipher);
+        for (uint32_t position = 0; position < cipher.size(); ++position) {
+            occurrences[cipher[position]].push_back(position);
+        }
+        for (uint32_t start = 0; start + 4 <= cipher.size(); ++start) {
+            for (uint32_t offset = 0; offset < 4; ++offset) {
+                auto& list = quadgrams[cipher[start + offset]];
+                if (list.empty() || list.back() != start) {
+                    list.push_back(start);
+                }
+            }
+        }
+    }
+
+    //one climb from a random key until no single swap improves the score
+    [[nodiscard]] solution climb(uint64_t seed) const {
+        uint64_t state = seed;
+        solution result;
+        result.key.resize(size);
+        std::iota(result.key.begin(), result.key.end(), 0);
+        for (size_t i = size - 1; i > 0; --i) {
+            std::swap(result.key[i], result.key[mix(state) % (i + 1)]);
+        }
+        auto& key = result.key;
+
+        std::vector<uint8_t> plain = decrypt(key);
+        for (uint32_t start = 0; start + 4 <= cipher.size(); ++start) {
+            result.score += score_at(plain, start);
+        }
+
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (size_t a = 0; a < size; ++a) {
+                for (size_t b = a + 1; b < size; ++b) {
+                    if (occurrences[a].empty() && occurrences[b].empty()) {
+                        continue;
+                    }
+                    double before = 0, after = 0;
+                    for_each_quadgram(a, b, [&](uint32_t start) { before += score_at(plain, start); });
+                    std::swap(key[a], key[b]);
+                    apply(plain, key, a);
+                    apply(plain, key, b);
+                    for_each_quadgram(a, b, [&](uint32_t start) { after += score_at(plain, start); });
+                    if (after > before) {
+                        result.score += after - before;
+                        improved = true;
+                    } else {
+                        std::swap(key[a], key[b]);
+                        apply(plain, key, a);
+                        apply(plain, key, b);
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    //restart number restart of seed, the same climb on every thread and every process
+    [[nodiscard]] solution climb_restart(uint64_t restart, uint64_t seed) const {
+        uint64_t state = seed ^ (restart * 0xd1b54a32d192ed03ULL);
+        solution result = climb(mix(state));
+        result.restart = restart;
+        return result;
+    }
+
+    /**
+     * Independent climbs spread over threads (0 = all cores). Restart r always starts from the
+     * same key for a given seed and ties go to the lowest restart, so the result does not depend
+     * on the thread count.
+     */
+    [[nodiscard]] solution solve(size_t restarts, size_t threads = 0, uint64_t seed = 0) const {
+        std::vector<size_t> bounds = chunk_bounds(std::max<size_t>(restarts, 1), threads, 1);
+        std::vector<solution> best(bounds.size() - 1);
+        for_each_chunk(bounds, [&](size_t chunk, size_t begin, size_t end) {
+            for (size_t restart = begin; restart < end; ++restart) {
+                solution candidate = climb_restart(restart, seed);
+                if (restart == begin || candidate.score > best[chunk].score) {
+                    best[chunk] = std::move(candidate);
+                }
+            }
+        });
+        solution result = std::move(best[0]);
+        for (size_t chunk = 1; chunk < best.size(); ++chunk) {
+            if (best[chunk].score > result.score) {
+                result = std::move(best[chunk]);
+            }
+        }
+        return result;
+    }
+
+    //plaintext alphabet indices of the ciphertext under key
+    [[nodiscard]] std::vector<uint8_t> decrypt(const std::vector<uint8_t>& key) const {
+        std::vector<uint8_t> plain(cipher.size());
+        for (size_t i = 0; i < cipher.size(); ++i) {
+            plain[i] = key[cipher[i]];
+        }
+        return plain;
+    }
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <codecvt>
+#include <locale>
+#include <stdexcept>
+#include "quadgram_model.h"
+
+namespace solver {
+
+/**
+ * Ciphertext symbols numbered in order of first appearance, together with what they looked like
+ * in the input, so the recovered key can be printed in the ciphertext's own terms.
+ */
+struct ciphertext {
+    std::vector<uint8_t> indices;
+    std::vector<std::string> symbols;
+
+    void add(const std::string& symbol) {
+        auto it = std::find(symbols.begin(), symbols.end(), symbol);
+        indices.push_back(uint8_t(std::distance(symbols.begin(), it)));
+        if (it == symbols.end()) {
+            symbols.push_back(symbol);
+        }
+    }
+};
+
+//every symbol of the text is a ciphertext symbol, e.g. Caesar with a keyed alphabet
+inline ciphertext read_text(const std::string& utf8) {
+    std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
+    ciphertext result;
+    for (wchar_t symbol : converter.from_bytes(utf8)) {
+        if (symbol != L'\n' && symbol != L'\r') {
+            result.add(converter.to_bytes(symbol));
+        }
+    }
+    return result;
+}
+
+//whitespace separated numbers, e.g. the output of the direct substitution exercise under an unknown table
+inline ciphertext read_codes(const std::string& text) {
+    std::istringstream in(text);
+    ciphertext result;
+    std::string code;
+    while (in >> code) {
+        result.add(code);
+    }
+    return result;
+}
+
+inline std::string read_all(std::istream& in) {
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+//trains the model on the corpus file, or maps the table file built by CryptoNgrams
+template<typename Alphabet>
+quadgram_model<Alphabet> load_model(const std::string& corpus_path, const std::string& model_path) {
+    if (!model_path.empty()) {
+        return quadgram_model<Alphabet>::load(model_path);
+    }
+    std::ifstream corpus_file(corpus_path, std::ios::binary);
+    if (!corpus_file) {
+        throw std::runtime_error("Cannot open " + corpus_path);
+    }
+    std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
+    return quadgram_model<Alphabet>::train(converter.from_bytes(read_all(corpus_file)));
+}
+
+}
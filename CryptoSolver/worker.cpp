@@ -0,0 +1,113 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include "alphabet.h"
+#include "quadgram_model.h"
+#include "keyspace.h"
+#include "shard_protocol.h"
+#include "solver_io.h"
+
+/**
+ * A CryptoKeySearch worker: connects to the coordinator, takes the job and searches shard after shard
+ * with all its threads until the coordinator closes the connection. Workers hold no state the coordinator
+ * cannot recreate, so a killed worker only costs the shard it was working on.
+ */
+
+struct options {
+    std::string address;
+    std::string corpus_path;
+    std::string model_path;
+    size_t threads = 0;
+};
+
+template<typename Alphabet>
+void search(int fd, const keyspace::job& task, const options& config) {
+    auto model = solver::load_model<Alphabet>(config.corpus_path, config.model_path);
+    keyspace::searcher<Alphabet> worker(task, model, config.threads);
+    std::string body;
+    while (read_frame(fd, body)) {
+        shards::message_reader in(body);
+        if (in.type() != shards::SHARD) {
+            throw std::runtime_error("Unexpected message");
+        }
+        keyspace::shard part = shards::read_shard(in);
+        shards::send_result(fd, part.id, worker.run(part));
+    }
+}
+
+//the coordinator may start after its workers, so connecting is retried for a while
+int connect_with_retries(const std::string& address) {
+    for (int attempt = 0; attempt < 300; ++attempt) {
+        int fd = shards::connect_to(address);
+        if (fd >= 0) {
+            return fd;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    throw std::runtime_error("No coordinator at " + address);
+}
+
+void print_usage() {
+    std::cerr << "Usage: CryptoKeySearchWorker --connect path|host:port --corpus training.txt|--model table.bin\n"
+                 "                             [--threads count]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    options config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 == argc) {
+            print_usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--connect") {
+            config.address = value;
+        } else if (arg == "--corpus") {
+            config.corpus_path = value;
+        } else if (arg == "--model") {
+            config.model_path = value;
+        } else if (arg == "--threads") {
+            config.threads = std::stoul(value);
+        } else {
+            print_usage();
+            return 2;
+        }
+    }
+    if (config.address.empty() || config.corpus_path.empty() == config.model_path.empty()) {
+        print_usage();
+        return 2;
+    }
+    if (config.threads == 0) {
+        config.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    try {
+        int fd = connect_with_retries(config.address);
+        shards::send_hello(fd, config.threads);
+        std::string body;
+        if (!read_frame(fd, body)) {
+            return 0;
+        }
+        shards::message_reader in(body);
+        if (in.type() != shards::JOB) {
+            throw std::runtime_error("Unexpected message");
+        }
+        keyspace::job task = shards::read_job(in);
+        if (task.alphabet == "cyrillic") {
+            search<alphabets::cyrillic_digits>(fd, task, config);
+        } else if (task.alphabet == "latin") {
+            search<alphabets::latin>(fd, task, config);
+        } else {
+            throw std::runtime_error("Unknown alphabet " + task.alphabet);
+        }
+        close(fd);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
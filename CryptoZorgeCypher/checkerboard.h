@@ -0,0 +1,175 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <cctype>
+#include "alphabet.h"
+#include "key_cache.h"
+#include "instrumentation.h"
+
+namespace zorge {
+
+using symbols_type = alphabets::checkerboard;
+constexpr const auto& symbol_set = alphabets::checkerboard_traits::symbols;
+constexpr const int DISPLAY_BATCH_SIZE = 5;
+constexpr const int STARTING_SYMBOL_INDEX = 80;
+constexpr const int REQUIRED_KEY_LEN = 6;
+
+inline bool has_repeating_chars(const std::string& string) {
+    int hash[256] = { 0 };
+    for (char ch : string) {
+        if (hash[ch] == 0) {
+            hash[ch]++;
+        } else if (hash[ch] == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//symbols with one-digit codes, coded by their position
+constexpr const char most_frequent_symbols[] = "ETAONRIS";
+//longest code of one symbol: two digits
+constexpr const size_t max_code_chars = 2;
+
+class encryptor {
+    void validate_key(const std::string& key) const {
+        if (key.size() != REQUIRED_KEY_LEN) {
+            throw std::logic_error("Invalid key size");
+        }
+        if (has_repeating_chars(key)) {
+            throw std::logic_error("Key has repeating characters");
+        }
+        for (char ch : key) {
+            if (!symbols_type::contains(ch)) {
+                throw std::logic_error("Key has illegal symbol");
+            }
+        }
+    }
+
+public:
+    struct checkerboard {
+        //the key followed by the remaining symbols in alphabet order, in rows of key length
+        std::array<char, symbols_type::size> matrix;
+        size_t row_length;
+        //code of every symbol on the board by its unsigned char value, -1 for the rest
+        std::array<int, 256> symbol_to_index;
+    };
+
+private:
+    static void display_matrix(const checkerboard& board) {
+        const size_t row_length = board.row_length;
+        const size_t size = board.matrix.size();
+        size_t rows = (size / row_length) + (size % row_length == 0 ? 0 : 1);
+
+        for (size_t row_idx = 0; row_idx < rows; ++row_idx) {
+            size_t limit = row_idx + 1 == rows ? row_length - (row_length - (size % row_length)) : row_length;
+
+            for (size_t col_idx = 0; col_idx < limit; ++col_idx) {
+                std::cout << board.matrix[row_idx * row_length + col_idx] << "  ";
+            }
+            std::cout << std::endl;
+            for (size_t col_idx = 0; col_idx < limit; ++col_idx) {
+                int idx = board.symbol_to_index[uint8_t(board.matrix[row_idx * row_length + col_idx])];
+                std::cout << idx << (idx > 10 ? " " : "  ");
+            }
+            std::cout << std::endl;
+        }
+    }
+
+public:
+    [[nodiscard]] checkerboard build_checkerboard(const std::string& key) const {
+        validate_key(key);
+
+        checkerboard board{};
+        board.row_length = key.size();
+        board.symbol_to_index.fill(-1);
+        for (int i = 0; most_frequent_symbols[i] != '\0'; ++i) {
+            board.symbol_to_index[uint8_t(most_frequent_symbols[i])] = i;
+        }
+
+        size_t size = std::copy(key.begin(), key.end(), board.matrix.begin()) - board.matrix.begin();
+        for (size_t i = 0; i < symbols_type::size; ++i) {
+            char ch = symbols_type::symbol_at(i);
+            if (key.find(ch) == std::string::npos) {
+                board.matrix[size++] = ch;
+            }
+        }
+
+        int index = STARTING_SYMBOL_INDEX;
+        const size_t row_length = board.row_length;
+        size_t rows = (size / row_length) + (size % row_length == 0 ? 0 : 1);
+
+        for (size_t col_idx = 0; col_idx < row_length; ++col_idx) {
+            for (size_t row_idx = 0; row_idx < rows; ++row_idx) {
+                if (row_idx * row_length + col_idx >= size) {
+                    break;
+                }
+                int& code = board.symbol_to_index[uint8_t(board.matrix[row_idx * row_length + col_idx])];
+                if (code == -1) {
+                    code = index++;
+                }
+            }
+        }
+        return board;
+    }
+
+    //build_checkerboard of recently used keys, see key_cache.h
+    [[nodiscard]] checkerboard cached_checkerboard(const std::string& key) const {
+        static key_caches::key_cache<char, checkerboard> cache("zorge", key_caches::configured_capacity());
+        return cache.get(key, [this](std::string_view text) { return build_checkerboard(std::string(text)); });
+    }
+
+    void display_checkerboard(const std::string& key) const {
+        display_matrix(build_checkerboard(key));
+    }
+
+    /**
+     * Writes the codes of [begin, end) through the output iterator out and returns it advanced past them.
+     * Digits are written twice, everything else as its code. Lets a following stage consume the codes
+     * as they are produced, see block_transposition::block_writer.
+     */
+    template<typename Out>
+    static Out encrypt_to(const char* begin, const char* end, const checkerboard& board, Out out) {
+        INSTRUMENT_STAGE("zorge.encrypt", end - begin);
+        for (const char* it = begin; it != end; ++it) {
+            char ch = *it;
+            if (isdigit(ch)) {
+                *out++ = ch;
+                *out++ = ch;
+                continue;
+            }
+            int code = board.symbol_to_index[uint8_t(ch)];
+            if (code == -1) {
+                throw illegal_symbol(it - begin, uint8_t(ch));
+            }
+            if (code >= 10) {
+                *out++ = char('0' + code / 10);
+            }
+            *out++ = char('0' + code % 10);
+        }
+        return out;
+    }
+
+    /**
+     * Encrypts [begin, end) into out, which has room for max_code_chars per symbol, and returns the number
+     * of digits written. Does not allocate.
+     */
+    static size_t encrypt_into(const char* begin, const char* end, const checkerboard& board, char* out) {
+        return encrypt_to(begin, end, board, out) - out;
+    }
+
+    std::string encrypt(const std::string& formatted_text, const std::string& key) const {
+        checkerboard board = cached_checkerboard(key);
+        std::string result(formatted_text.size() * max_code_chars, '\0');
+        result.resize(encrypt_into(formatted_text.data(), formatted_text.data() + formatted_text.size(), board,
+                                   &result[0]));
+        return result;
+    }
+};
+
+}
@@ -1,8 +1,11 @@
+#pragma once
+
 #include <tuple>
 #include <vector>
 #include <cctype>
 #include <cstring>
 #include <unordered_set>
+#include "instrumentation.h"
 
 enum format_type { INSERT_BEFORE, REPLACE, ERASE, SKIP };
 
@@ -79,6 +82,7 @@ public:
     }
 
     [[nodiscard]] std::string format_text(const std::string& text) const {
+        INSTRUMENT_STAGE("zorge.format", text.size());
         std::string result(text);
         size_t text_size = text.size();
 